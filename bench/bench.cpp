@@ -0,0 +1,499 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <filesystem>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "include/audio.h"
+#include "include/player.h"
+#include "include/sequence.h"
+
+// Throughput and latency benchmarks for the importers, the CSV exporter, the analysis kernel, note editing, the note
+// ring and the playback scheduler. Every benchmark runs once to warm up and then `--repeat` times; the median is reported and compared
+// against a baseline saved with `--save`.
+
+struct Benchmark
+{
+    std::string name;
+    // Returns false when the operation failed; its time would mean nothing.
+    std::function<bool(std::vector<std::pair<int, int>> &)> run;
+    size_t bytes = 0;
+};
+
+struct Result
+{
+    std::string name;
+    std::vector<std::pair<std::string, double>> values;
+    bool failed = false;
+};
+
+struct Options
+{
+    std::string fixtures = "tests", filter, baseline, save;
+    int repeat = 7, scale = 16, load = 0;
+    // Percent for medians; jitter is compared in absolute microseconds, since its p99 swings by far more than 10%
+    // between otherwise identical runs.
+    double threshold = 10, jitterThreshold = 500;
+};
+
+static std::filesystem::path scratch;
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    auto middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) return 0;
+
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(fraction * static_cast<double>(values.size() - 1))];
+}
+
+static std::vector<char> readFile(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static std::filesystem::path writeFile(const std::string &name, const std::vector<char> &bytes)
+{
+    auto path = scratch / name;
+    std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<long>(bytes.size()));
+    return path;
+}
+
+// Synthetic notes with a spread of frequencies and durations, so the varint and entropy coders see realistic data.
+static std::vector<std::pair<int, int>> syntheticNotes(size_t count)
+{
+    std::vector<std::pair<int, int>> notes(count);
+    for (size_t i = 0; i < count; ++i)
+        notes[i] = {static_cast<int>(220 + (i * 7919) % 660), static_cast<int>(20 + (i * 104729) % 480)};
+
+    return notes;
+}
+
+// Repeats the PCM data of a WAV file `scale` times behind its original header.
+static std::filesystem::path scaleWAV(const std::filesystem::path &source, int scale)
+{
+    auto original = readFile(source);
+    if (original.size() <= 44) return source;
+
+    std::vector<char> scaled(original.begin(), original.begin() + 44);
+    for (int i = 0; i < scale; ++i) scaled.insert(scaled.end(), original.begin() + 44, original.end());
+
+    auto riffSize = static_cast<uint32_t>(scaled.size() - 8), dataSize = static_cast<uint32_t>(scaled.size() - 44);
+    std::memcpy(&scaled[4], &riffSize, sizeof(riffSize));
+    std::memcpy(&scaled[40], &dataSize, sizeof(dataSize));
+    return writeFile("scaled.wav", scaled);
+}
+
+// MP3 frames are self-contained, so concatenating a file with itself makes a valid longer stream.
+static std::filesystem::path scaleMP3(const std::filesystem::path &source, int scale)
+{
+    auto original = readFile(source);
+    std::vector<char> scaled;
+    for (int i = 0; i < scale; ++i) scaled.insert(scaled.end(), original.begin(), original.end());
+
+    return writeFile("scaled.mp3", scaled);
+}
+
+// A format 0 file with one short event per note, in the layout importMIDI parses.
+static std::filesystem::path syntheticMIDI(size_t count)
+{
+    auto varint = [](std::vector<char> &out, uint32_t value)
+    {
+        char bytes[5];
+        int size = 0;
+        do bytes[size++] = static_cast<char>(value & 0x7F); while (value >>= 7);
+        while (size--) out.push_back(static_cast<char>(bytes[size] | (size ? 0x80 : 0)));
+    };
+
+    std::vector<char> track;
+    for (size_t i = 0; i < count; ++i)
+    {
+        varint(track, 0);
+        track.push_back(static_cast<char>(1 + i % 120));
+        varint(track, static_cast<uint32_t>(20 + i % 480));
+    }
+
+    std::vector<char> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96, 'M', 'T', 'r', 'k'};
+    for (int shift = 24; shift >= 0; shift -= 8) file.push_back(static_cast<char>(track.size() >> shift));
+    file.insert(file.end(), track.begin(), track.end());
+    return writeFile("synthetic.mid", file);
+}
+
+static std::filesystem::path syntheticCSV(size_t count)
+{
+    std::stringstream csv;
+    csv << "Frequency (Hz),Duration (ms)\n";
+    for (auto &[freq, duration]: syntheticNotes(count)) csv << freq << ',' << duration << '\n';
+
+    auto text = csv.str();
+    return writeFile("synthetic.csv", {text.begin(), text.end()});
+}
+
+static Benchmark importer(const std::string &name, bool (* import)(std::vector<std::pair<int, int>> &, const char*),
+                          const std::filesystem::path &path)
+{
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    return {name, [import, path = path.string()](auto &data) { return import(data, path.c_str()); }, ec ? 0 : size};
+}
+
+static Result measure(const Benchmark &benchmark, int repeat)
+{
+    std::vector<double> seconds;
+    size_t notes = 0;
+
+    for (int i = 0; i <= repeat; ++i)
+    {
+        std::vector<std::pair<int, int>> data;
+        auto start = std::chrono::steady_clock::now();
+        auto succeeded = benchmark.run(data);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!succeeded) return {benchmark.name, {}, true};
+
+        // The first run only warms caches and the allocator.
+        if (i == 0) continue;
+        seconds.push_back(elapsed);
+        notes = data.size();
+    }
+
+    auto mid = median(seconds);
+    auto mean = std::accumulate(seconds.begin(), seconds.end(), 0.0) / static_cast<double>(seconds.size());
+    auto variance = std::accumulate(seconds.begin(), seconds.end(), 0.0, [mean](double sum, double value)
+    {
+        return sum + (value - mean) * (value - mean);
+    }) / static_cast<double>(seconds.size());
+
+    return {benchmark.name, {{"median_ms", mid * 1000},
+                             {"stddev_pct", mean > 0 ? std::sqrt(variance) / mean * 100 : 0},
+                             {"mb_per_s", static_cast<double>(benchmark.bytes) / (1 << 20) / mid},
+                             {"notes_per_s", static_cast<double>(notes) / mid}}};
+}
+
+// Records when each tone starts, so lateness can be measured against the ideal schedule.
+class MockSink : public Player::Sink
+{
+public:
+    explicit MockSink(std::vector<std::chrono::steady_clock::time_point> &starts) : starts(starts) {}
+
+    bool tone(int) override
+    {
+        starts.push_back(std::chrono::steady_clock::now());
+        return true;
+    }
+
+    void silence() override {}
+
+private:
+    std::vector<std::chrono::steady_clock::time_point> &starts;
+};
+
+// `load` busy threads compete with the player to mimic a loaded host.
+static Result measureJitter(int repeat, bool realTime, int load)
+{
+    constexpr int NOTES = 100, DURATION = 2;
+    std::vector<double> lateness;
+    NoteSequence notes(std::vector<std::pair<int, int>>(NOTES, {440, DURATION}));
+
+    std::atomic<bool> loaded = true;
+    std::vector<std::thread> spinners;
+    for (int i = 0; i < load; ++i) spinners.emplace_back([&loaded] { while (loaded) {} });
+
+    for (int i = 0; i < repeat; ++i)
+    {
+        std::vector<std::chrono::steady_clock::time_point> starts;
+        starts.reserve(NOTES);
+
+        Player player;
+        player.realTime.enabled = realTime;
+        player.play(notes, 0, std::make_unique<MockSink>(starts));
+        while (player.playing()) std::this_thread::sleep_for(std::chrono::milliseconds(DURATION * 10));
+        player.stop();
+
+        for (size_t note = 1; note < starts.size(); ++note)
+        {
+            auto expected = starts.front() + std::chrono::milliseconds(DURATION * note);
+            lateness.push_back(std::chrono::duration<double, std::micro>(starts[note] - expected).count());
+        }
+    }
+
+    loaded = false;
+    for (auto &spinner: spinners) spinner.join();
+
+    return {realTime ? "playback.jitter.realtime" : "playback.jitter", {{"p99_us", percentile(lateness, 0.99)},
+                                {"p50_us", percentile(lateness, 0.50)},
+                                {"max_us", percentile(lateness, 1.0)}}};
+}
+
+// Reads a file written by `--save`: one benchmark per line, compared on its first value.
+static std::vector<std::pair<std::string, double>> loadBaseline(const std::string &path)
+{
+    std::vector<std::pair<std::string, double>> baseline;
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        error("Failed to open baseline: " + std::string(strerror(errno)));
+        return baseline;
+    }
+
+    for (std::string line; std::getline(file, line);)
+    {
+        auto nameStart = line.find('"'), nameEnd = line.find('"', nameStart + 1);
+        auto colon = line.find(':', line.find('"', line.find('"', nameEnd + 1) + 1));
+        if (nameStart == std::string::npos || nameEnd == std::string::npos || colon == std::string::npos) continue;
+
+        baseline.emplace_back(line.substr(nameStart + 1, nameEnd - nameStart - 1), std::atof(line.c_str() + colon + 1));
+    }
+
+    return baseline;
+}
+
+static bool save(const std::vector<Result> &results, const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Failed benchmarks have nothing to compare against, so they are left out.
+    std::vector<const Result*> saved;
+    for (auto &result: results)
+        if (!result.failed) saved.push_back(&result);
+
+    file << "{\n";
+    for (size_t i = 0; i < saved.size(); ++i)
+    {
+        file << "  \"" << saved[i]->name << "\": {";
+        for (size_t j = 0; j < saved[i]->values.size(); ++j)
+            file << (j ? ", " : "") << '"' << saved[i]->values[j].first << "\": " << saved[i]->values[j].second;
+
+        file << '}' << (i + 1 < saved.size() ? "," : "") << '\n';
+    }
+
+    file << "}\n";
+    return file.good();
+}
+
+static int usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--fixtures <directory>] [--filter <text>] [--repeat <count>] "
+                                         "[--scale <factor>] [--load <threads>] [--save <file>] "
+                                         "[--baseline <file> [--threshold <percent>] [--jitter-threshold <us>]]"
+              << std::endl;
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return usage(argv[0]);
+
+        if (arg == "--fixtures") options.fixtures = argv[++i];
+        else if (arg == "--filter") options.filter = argv[++i];
+        else if (arg == "--baseline") options.baseline = argv[++i];
+        else if (arg == "--save") options.save = argv[++i];
+        else if (arg == "--repeat") options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--scale") options.scale = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threshold") options.threshold = std::atof(argv[++i]);
+        else if (arg == "--jitter-threshold") options.jitterThreshold = std::atof(argv[++i]);
+        else if (arg == "--load") options.load = std::max(0, std::atoi(argv[++i]));
+        else return usage(argv[0]);
+    }
+
+    // Imports must really decode every time, and the log lines would drown the report.
+    ImportCache::enabled = false;
+    AudioManager::skipHeader = true;
+    std::clog.setstate(std::ios::failbit);
+
+    scratch = std::filesystem::temp_directory_path() / ("soundtest-bench-" + std::to_string(getpid()));
+    std::filesystem::create_directories(scratch);
+
+    std::filesystem::path fixtures = options.fixtures;
+    auto notes = syntheticNotes(static_cast<size_t>(options.scale) * 65536);
+    AudioManager::exportBinary(notes, (scratch / "synthetic.stn").c_str());
+    AudioManager::exportArchive(notes, (scratch / "synthetic.stz").c_str());
+
+    auto scaled = "x" + std::to_string(options.scale);
+    std::vector<Benchmark> benchmarks = {
+        importer("import.wav", AudioManager::importWAV, fixtures / "1.wav"),
+        importer("import.wav." + scaled, AudioManager::importWAV, scaleWAV(fixtures / "1.wav", options.scale)),
+        importer("import.midi", AudioManager::importMIDI, fixtures / "3.mid"),
+        importer("import.midi.synthetic", AudioManager::importMIDI, syntheticMIDI(notes.size())),
+        importer("import.csv", AudioManager::importCSV, fixtures / "5.csv"),
+        importer("import.csv.synthetic", AudioManager::importCSV, syntheticCSV(notes.size())),
+        importer("import.binary", AudioManager::importBinary, scratch / "synthetic.stn"),
+        importer("import.archive", AudioManager::importArchive, scratch / "synthetic.stz"),
+    };
+
+    // MP3 decoding lives in a plugin; without it those benchmarks would only time the failure.
+    if (PluginRegistry::get("mp3"))
+    {
+        benchmarks.push_back(importer("import.mp3", AudioManager::importMP3, fixtures / "4.mp3"));
+        benchmarks.push_back(importer("import.mp3." + scaled, AudioManager::importMP3,
+                                      scaleMP3(fixtures / "4.mp3", options.scale)));
+    }
+
+    auto csvPath = (scratch / "export.csv").string();
+    benchmarks.push_back({"export.csv", [&notes, csvPath](auto &data)
+    {
+        data.resize(notes.size());
+        return AudioManager::exportCSV(notes, csvPath.c_str());
+    }, 0});
+
+    // One chunk analysis per CHUNK_SIZE samples of a sine with a slowly changing amplitude.
+    std::vector<short> pcm(static_cast<size_t>(options.scale) * (1 << 20));
+    for (size_t i = 0; i < pcm.size(); ++i)
+        pcm[i] = static_cast<short>(std::sin(static_cast<double>(i) * 0.05) * (1000.0 + static_cast<double>(i % 30000)));
+
+    benchmarks.push_back({"analyse.chunks", [&pcm](auto &data)
+    {
+        Analyser analyser(data, 44100);
+        for (auto sample: pcm) analyser.push(sample);
+        analyser.finish();
+        return true;
+    }, pcm.size() * sizeof(short)});
+
+    // GUI edits on the synthetic sequence: deleting near the front and moving one note across half of it. Each run
+    // edits a copy, which shares chunks with the original until they are written.
+    constexpr int EDITS = 1000;
+    NoteSequence sequence(notes);
+    benchmarks.push_back({"edit.erase_front", [&sequence](auto &data)
+    {
+        auto copy = sequence;
+        for (int i = 0; i < EDITS; ++i) copy.erase(10, 11);
+        data.resize(EDITS);
+        return true;
+    }, 0});
+    benchmarks.push_back({"edit.move", [&sequence](auto &data)
+    {
+        auto copy = sequence;
+        for (int i = 0; i < EDITS; ++i) copy.rotate(10, copy.size() / 2, copy.size() / 2 + 1);
+        data.resize(EDITS);
+        return true;
+    }, 0});
+
+    // Note events through a shared memory ring, pushed and popped a ring's worth at a time. The ring is unlinked
+    // straight away; the mapping stays valid until it is closed.
+    NoteRing ring;
+    auto ringName = "/soundtest-bench-" + std::to_string(getpid());
+    if (ring.open(ringName))
+    {
+        NoteRing::unlink(ringName);
+        benchmarks.push_back({"ring.transfer", [&ring, &notes](auto &data)
+        {
+            std::vector<NoteEvent> events(ring.capacity());
+            data.reserve(notes.size());
+            for (size_t i = 0; i < notes.size(); i += events.size())
+            {
+                auto count = std::min(events.size(), notes.size() - i);
+                for (size_t j = 0; j < count; ++j) events[j] = {notes[i + j].first, notes[i + j].second};
+                ring.push(events.data(), count);
+                for (NoteEvent event; ring.pop(event);) data.emplace_back(event.frequency, event.duration);
+            }
+
+            // Every event must come out again; an overrun would mean the ring lost some.
+            return data.size() == notes.size();
+        }, notes.size() * sizeof(NoteEvent)});
+    }
+
+    std::vector<Result> results;
+    std::cout << std::left << std::setw(26) << "benchmark" << std::right << std::setw(12) << "median ms"
+              << std::setw(9) << "+-%" << std::setw(11) << "MB/s" << std::setw(14) << "notes/s" << std::endl;
+
+    for (auto &benchmark: benchmarks)
+    {
+        if (benchmark.name.find(options.filter) == std::string::npos) continue;
+
+        // The export benchmark's size is only known once it has run.
+        if (benchmark.name == "export.csv")
+        {
+            std::vector<std::pair<int, int>> data;
+            benchmark.run(data);
+            std::error_code ec;
+            benchmark.bytes = std::filesystem::file_size(csvPath, ec);
+        }
+
+        auto result = measure(benchmark, options.repeat);
+        results.push_back(result);
+        if (result.failed)
+        {
+            std::cout << std::left << std::setw(26) << result.name << std::right << std::setw(12) << "FAILED"
+                      << std::endl;
+            continue;
+        }
+
+        std::cout << std::left << std::setw(26) << result.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << result.values[0].second << std::setw(9) << result.values[1].second
+                  << std::setw(11) << result.values[2].second << std::setprecision(0) << std::setw(14)
+                  << result.values[3].second << std::endl;
+    }
+
+    for (auto realTime: {false, true})
+    {
+        std::string name = realTime ? "playback.jitter.realtime" : "playback.jitter";
+        if (name.find(options.filter) == std::string::npos) continue;
+
+        auto result = measureJitter(options.repeat, realTime, options.load);
+        std::cout << std::left << std::setw(26) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << "p50 " << result.values[1].second << " us, p99 " << result.values[0].second << " us, max "
+                  << result.values[2].second << " us" << std::endl;
+        results.push_back(result);
+    }
+
+    std::filesystem::remove_all(scratch);
+    if (!options.save.empty() && !save(results, options.save)) return EXIT_FAILURE;
+    if (options.baseline.empty()) return EXIT_SUCCESS;
+
+    // Both median time and p99 jitter are "lower is better", so a rise above the threshold is a regression. A benchmark
+    // that failed is one too, whether or not the baseline has it.
+    int regressions = 0;
+    std::cout << std::endl << std::left << std::setw(26) << "benchmark" << std::right << std::setw(12) << "baseline"
+              << std::setw(12) << "current" << std::setw(10) << "change" << std::endl;
+
+    for (auto &result: results)
+        if (result.failed)
+        {
+            std::cout << std::left << std::setw(26) << result.name << std::right << std::setw(34) << "FAILED"
+                      << std::endl;
+            ++regressions;
+        }
+
+    for (auto &[name, before]: loadBaseline(options.baseline))
+    {
+        auto result = std::find_if(results.begin(), results.end(), [&name](auto &r) { return r.name == name; });
+        if (result == results.end() || result->failed || before <= 0) continue;
+
+        auto after = result->values[0].second;
+        auto jitter = name.starts_with("playback.jitter");
+        auto change = jitter ? after - before : (after / before - 1) * 100;
+        auto regressed = change > (jitter ? options.jitterThreshold : options.threshold);
+        regressions += regressed;
+
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << before << std::setw(12) << after << std::setw(jitter ? 8 : 9) << std::showpos
+                  << change << (jitter ? "us" : "%") << std::noshowpos << (regressed ? "  REGRESSED" : "")
+                  << std::endl;
+    }
+
+    return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
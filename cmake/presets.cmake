@@ -0,0 +1,62 @@
+# Generates a C++ source with one constexpr note array per lib/res/*.csv and a registry of all presets.
+# Usage: cmake -DRESOURCES=<lib/res> -DOUTPUT=<presets.cpp> -P presets.cmake
+
+cmake_minimum_required(VERSION 3.20)
+
+file(GLOB CSV_FILES RELATIVE ${RESOURCES} ${RESOURCES}/*.csv)
+list(SORT CSV_FILES)
+
+# presets.txt lists "file.csv=Title" in display order; files missing from it are appended under their own name.
+set(ORDERED_FILES "")
+if (EXISTS ${RESOURCES}/presets.txt)
+    file(STRINGS ${RESOURCES}/presets.txt MANIFEST ENCODING UTF-8)
+    foreach (ENTRY ${MANIFEST})
+        string(REGEX MATCH "^([^=]+)=(.*)$" MATCHED "${ENTRY}")
+        if (MATCHED AND "${CMAKE_MATCH_1}" IN_LIST CSV_FILES)
+            list(APPEND ORDERED_FILES ${CMAKE_MATCH_1})
+            set(TITLE_${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+        endif ()
+    endforeach ()
+endif ()
+
+foreach (CSV_FILE ${CSV_FILES})
+    if (NOT CSV_FILE IN_LIST ORDERED_FILES)
+        list(APPEND ORDERED_FILES ${CSV_FILE})
+        get_filename_component(STEM ${CSV_FILE} NAME_WE)
+        set(TITLE_${CSV_FILE} "${STEM}")
+    endif ()
+endforeach ()
+
+set(SOURCE "// Generated by cmake/presets.cmake from lib/res/*.csv. Do not edit.\n\n#include \"include/presets.h\"\n")
+set(REGISTRY "")
+
+foreach (CSV_FILE ${ORDERED_FILES})
+    get_filename_component(STEM ${CSV_FILE} NAME_WE)
+    string(MAKE_C_IDENTIFIER "PRESET_${STEM}" ARRAY)
+    string(TOUPPER ${ARRAY} ARRAY)
+
+    # Values are truncated to integers the same way AudioManager::importCSV does; non-numeric lines are skipped.
+    file(STRINGS ${RESOURCES}/${CSV_FILE} LINES)
+    set(NOTES "")
+    foreach (LINE ${LINES})
+        if (LINE MATCHES "^[ \t]*(-?[0-9]+)[^,]*,[ \t]*(-?[0-9]+)")
+            string(APPEND NOTES "    {${CMAKE_MATCH_1}, ${CMAKE_MATCH_2}},\n")
+        endif ()
+    endforeach ()
+
+    string(REPLACE "\\" "\\\\" TITLE "${TITLE_${CSV_FILE}}")
+    string(REPLACE "\"" "\\\"" TITLE "${TITLE}")
+
+    string(APPEND SOURCE "\nstatic constexpr std::pair<int, int> ${ARRAY}[] = {\n${NOTES}};\n")
+    string(APPEND REGISTRY "    {\"${TITLE}\", ${ARRAY}, std::size(${ARRAY})},\n")
+endforeach ()
+
+string(APPEND SOURCE "\nconst Preset PRESETS[] = {\n${REGISTRY}};\n\nconst size_t PRESET_COUNT = std::size(PRESETS);\n")
+
+# Only touch the output when it changes so unrelated reconfigures do not trigger a rebuild.
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif ()
+if (NOT "${PREVIOUS}" STREQUAL "${SOURCE}")
+    file(WRITE ${OUTPUT} "${SOURCE}")
+endif ()
@@ -0,0 +1,125 @@
+#include "mp3.h"
+
+#include <mutex>
+
+#include "include/utils.h"
+
+Mp3Stream::Mp3Stream(const SoundTestSink &sink) : sink(sink)
+{
+    static std::once_flag mpg123Initialized;
+    std::call_once(mpg123Initialized, mpg123_init);
+
+    int err = 0;
+    handle = mpg123_new(nullptr, &err);
+    if (handle == nullptr)
+    {
+        error("Failed to create mpg123 handle: " + std::string(mpg123_plain_strerror(err)));
+        return;
+    }
+
+    if (mpg123_open_feed(handle) != MPG123_OK)
+    {
+        fail("Failed to initialize mpg123: " + std::string(mpg123_strerror(handle)));
+        return;
+    }
+
+    pcm.resize(mpg123_outblock(handle));
+}
+
+Mp3Stream::~Mp3Stream()
+{
+    if (!handle) return;
+
+    mpg123_close(handle);
+    mpg123_delete(handle);
+}
+
+void Mp3Stream::fail(const std::string &message)
+{
+    error(message);
+    mpg123_delete(handle);
+    handle = nullptr;
+}
+
+bool Mp3Stream::feed(const unsigned char* bytes, size_t size)
+{
+    if (!handle) return false;
+
+    size_t done = 0;
+    auto result = mpg123_decode(handle, bytes, size, pcm.data(), pcm.size(), &done);
+    return drain(result, done);
+}
+
+bool Mp3Stream::drain(int result, size_t done)
+{
+    while (true)
+    {
+        if (result == MPG123_NEW_FORMAT)
+        {
+            long rate = 0;
+            int channels = 0, encoding = 0;
+
+            mpg123_getformat(handle, &rate, &channels, &encoding);
+            if (encoding != MPG123_ENC_SIGNED_16)
+            {
+                fail("Unsupported MP3 file format! Only 16-bit MP3 files are supported. Found " +
+                     std::to_string(mpg123_encsize(encoding) * 8) + "-bit MP3 file.");
+                return false;
+            }
+
+            sink.format(sink.context, rate);
+            started = true;
+        }
+
+        if (started && done && !sink.write(sink.context, pcm.data(), done)) return false;
+
+        if (result == MPG123_NEED_MORE || result == MPG123_DONE) return true;
+        if (result != MPG123_OK && result != MPG123_NEW_FORMAT)
+        {
+            fail("Failed to decode MP3 data: " + std::string(mpg123_strerror(handle)));
+            return false;
+        }
+
+        done = 0;
+        result = mpg123_decode(handle, nullptr, 0, pcm.data(), pcm.size(), &done);
+    }
+}
+
+bool Mp3Stream::finish()
+{
+    if (!handle) return false;
+    if (!started)
+    {
+        fail("Failed to decode MP3 data: no audio frames found.");
+        return false;
+    }
+
+    return true;
+}
+
+static const SoundTestPlugin plugin = {
+    SOUNDTEST_PLUGIN_ABI, "mp3",
+    [](const SoundTestSink* sink) -> void*
+    {
+        auto stream = new Mp3Stream(*sink);
+        if (!stream->failed()) return stream;
+
+        delete stream;
+        return nullptr;
+    },
+    [](void* stream, const unsigned char* data, size_t size)
+    {
+        return static_cast<Mp3Stream*>(stream)->feed(data, size) ? 1 : 0;
+    },
+    [](void* stream) { return static_cast<Mp3Stream*>(stream)->finish() ? 1 : 0; },
+    [](void* stream) { delete static_cast<Mp3Stream*>(stream); },
+    nullptr
+};
+
+extern "C" __attribute__((visibility("default"))) const SoundTestPlugin* soundtest_plugin(const SoundTestHost* host)
+{
+    static const SoundTestHost* current;
+    current = host;
+    errorHandler = [](const std::string &message) { current->error(message.c_str()); };
+    return &plugin;
+}
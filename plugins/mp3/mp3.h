@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <mpg123.h>
+
+#include "include/plugin.h"
+
+// Incremental MP3 decoder built on mpg123's feed API. Encoded bytes can be fed in arbitrary pieces (for example
+// straight from a network transfer) and the decoded PCM goes straight to the host's sink.
+class Mp3Stream
+{
+public:
+    explicit Mp3Stream(const SoundTestSink &sink);
+    Mp3Stream(const Mp3Stream &) = delete;
+    Mp3Stream &operator=(const Mp3Stream &) = delete;
+    ~Mp3Stream();
+
+    bool feed(const unsigned char* bytes, size_t size);
+    bool finish();
+
+    [[nodiscard]] bool failed() const { return !handle; }
+
+private:
+    bool drain(int result, size_t done);
+    void fail(const std::string &message);
+
+    SoundTestSink sink;
+    mpg123_handle* handle = nullptr;
+    bool started = false;
+    std::vector<unsigned char> pcm;
+};
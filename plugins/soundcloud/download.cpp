@@ -0,0 +1,330 @@
+#include "download.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "include/cache.h"
+#include "include/hash.h"
+#include "include/utils.h"
+
+int DownloadCache::retries = 5;
+uintmax_t DownloadCache::limit = 1ULL << 30;
+std::filesystem::path DownloadCache::root;
+
+DownloadCache::DownloadCache(const std::string &url)
+{
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << Hash64::of(url.data(), url.size());
+
+    auto base = directory() / name.str();
+    body = base.string() + ".body";
+    part = base.string() + ".part";
+    etag = base.string() + ".etag";
+    lockFile = base.string() + ".lock";
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory(), ec);
+}
+
+std::filesystem::path DownloadCache::directory() { return root / "downloads"; }
+
+void DownloadCache::backoff(int attempt)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(250 << std::min(attempt - 1, 4)));
+}
+
+EntryLock::EntryLock(const std::filesystem::path &path) : fd(open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644))
+{
+    // Without a lock file (say, a read-only cache) the entry is used unlocked.
+    while (fd >= 0 && flock(fd, LOCK_EX) != 0 && errno == EINTR);
+}
+
+EntryLock::~EntryLock()
+{
+    if (fd >= 0) close(fd);
+}
+
+std::string DownloadCache::storedETag() const
+{
+    std::string value;
+    std::ifstream file(etag);
+    std::getline(file, value);
+
+    return value;
+}
+
+void DownloadCache::storeETag(const std::string &value) const
+{
+    std::error_code ec;
+    if (value.empty()) std::filesystem::remove(etag, ec);
+    else std::ofstream(etag) << value << '\n';
+}
+
+bool DownloadCache::commit(uintmax_t size) const
+{
+    // A part file of any other size lost bytes on the way to disk and must never be served as the whole body.
+    std::error_code ec;
+    if (std::filesystem::file_size(part, ec) != size || ec)
+    {
+        discard();
+        return false;
+    }
+
+    std::filesystem::rename(part, body, ec);
+    ImportCache::evict(directory(), limit, ".body");
+    return !ec;
+}
+
+void DownloadCache::discard() const
+{
+    std::error_code ec;
+    std::filesystem::remove(part, ec);
+    std::filesystem::remove(etag, ec);
+}
+
+bool DownloadCache::replay(const std::filesystem::path &path, uintmax_t from, uintmax_t to, const Sink &sink) const
+{
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(static_cast<long>(from));
+
+    std::vector<char> buffer(1 << 16);
+    while (from < to)
+    {
+        auto size = static_cast<long>(std::min<uintmax_t>(buffer.size(), to - from));
+        if (!file.read(buffer.data(), size)) return false;
+        if (!sink(reinterpret_cast<unsigned char*>(buffer.data()), static_cast<size_t>(size))) return false;
+
+        from += static_cast<uintmax_t>(size);
+    }
+
+    return true;
+}
+
+bool DownloadCache::fetch(const FetchManager::Request &request, const Sink &sink)
+{
+    struct Attempt
+    {
+        DownloadCache* cache = nullptr;
+        const Sink* sink = nullptr;
+        CURL* curl = nullptr;
+        std::ofstream output;
+        uintmax_t offset = 0, delivered = 0;
+        std::string etag;
+        bool started = false, aborted = false, caching = true;
+
+        // Stops caching once the part file cannot be written, say on a full disk; the transfer itself goes on.
+        void stopCaching()
+        {
+            std::clog << "Not caching download (" << strerror(errno) << "): " << cache->part.string() << std::endl;
+            output.close();
+            cache->discard();
+            caching = false;
+        }
+    };
+
+    curl_write_callback write = [](char* ptr, size_t size, size_t nmemb, void* userdata) -> size_t
+    {
+        auto &attempt = *static_cast<Attempt*>(userdata);
+        auto bytes = reinterpret_cast<unsigned char*>(ptr);
+
+        if (!attempt.started)
+        {
+            long status = 0;
+            curl_easy_getinfo(attempt.curl, CURLINFO_RESPONSE_CODE, &status);
+            attempt.started = true;
+
+            if (status == 206)
+            {
+                // Resumed: hand the sink whatever part of the stored prefix it has not seen yet.
+                if (!attempt.cache->replay(attempt.cache->part, attempt.delivered, attempt.offset, *attempt.sink))
+                {
+                    attempt.aborted = true;
+                    return 0;
+                }
+
+                attempt.delivered = attempt.offset;
+                attempt.output.open(attempt.cache->part, std::ios::binary | std::ios::app);
+            } else
+            {
+                // A full response after the sink already consumed bytes cannot be spliced into the stream.
+                if (attempt.delivered > 0)
+                {
+                    error("Download restarted from the beginning after bytes were already consumed.");
+                    attempt.aborted = true;
+                    return 0;
+                }
+
+                // The track changed, so the finished body is stale even if this transfer does not complete.
+                std::error_code ec;
+                std::filesystem::remove(attempt.cache->body, ec);
+                attempt.offset = 0;
+                attempt.output.open(attempt.cache->part, std::ios::binary | std::ios::trunc);
+            }
+
+            attempt.cache->storeETag(attempt.etag);
+            if (!attempt.output.is_open()) attempt.stopCaching();
+        }
+
+        if (attempt.caching && !attempt.output.write(ptr, static_cast<long>(size * nmemb))) attempt.stopCaching();
+        attempt.delivered += size * nmemb;
+        if (!(*attempt.sink)(bytes, size * nmemb))
+        {
+            attempt.aborted = true;
+            return 0;
+        }
+
+        return size * nmemb;
+    };
+
+    auto held = lock();
+    std::error_code ec;
+    uintmax_t delivered = 0;
+
+    for (int i = 0; i <= retries; ++i)
+    {
+        if (i > 0) backoff(i);
+
+        Attempt attempt;
+        attempt.cache = this;
+        attempt.sink = &sink;
+        attempt.curl = curl_easy_init();
+        attempt.delivered = delivered;
+
+        auto known = storedETag();
+        curl_slist* headers = nullptr;
+        for (auto &header: request.headers) headers = curl_slist_append(headers, header.c_str());
+
+        if (std::filesystem::exists(body, ec) && !known.empty() && delivered == 0)
+            headers = curl_slist_append(headers, ("If-None-Match: " + known).c_str());
+        else if (std::filesystem::exists(part, ec))
+        {
+            attempt.offset = std::filesystem::file_size(part, ec);
+            headers = curl_slist_append(headers, ("Range: bytes=" + std::to_string(attempt.offset) + "-").c_str());
+            if (!known.empty()) headers = curl_slist_append(headers, ("If-Range: " + known).c_str());
+        }
+
+        FetchManager::configure(attempt.curl);
+        curl_easy_setopt(attempt.curl, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(attempt.curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(attempt.curl, CURLOPT_WRITEFUNCTION, write);
+        curl_easy_setopt(attempt.curl, CURLOPT_WRITEDATA, &attempt);
+        curl_easy_setopt(attempt.curl, CURLOPT_HEADERFUNCTION, FetchManager::captureETag);
+        curl_easy_setopt(attempt.curl, CURLOPT_HEADERDATA, &attempt.etag);
+
+        auto result = curl_easy_perform(attempt.curl);
+        long status = 0;
+        curl_easy_getinfo(attempt.curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_easy_cleanup(attempt.curl);
+        curl_slist_free_all(headers);
+
+        // Buffered bytes that fail to reach the disk on close leave the part file short; commit() catches that.
+        attempt.output.close();
+        delivered = attempt.delivered;
+
+        if (attempt.aborted) return false;
+        if (result == CURLE_OK && status == 304)
+        {
+            std::filesystem::last_write_time(body, std::filesystem::file_time_type::clock::now(), ec);
+            std::clog << "Serving unchanged download from cache: " << request.url << std::endl;
+            return replay(body, 0, std::filesystem::file_size(body, ec), sink);
+        }
+
+        // The stored part already holds the whole body; the interrupted transfer only missed the end of the response.
+        if (status == 416 && attempt.offset > 0)
+        {
+            if (!replay(part, delivered, attempt.offset, sink)) return false;
+            commit(attempt.offset);
+            return true;
+        }
+
+        if (result == CURLE_OK)
+        {
+            if (!attempt.started) std::ofstream(part, std::ios::binary | std::ios::trunc);
+            if (attempt.caching) commit(delivered);
+            return true;
+        }
+
+        // HTTP errors other than the ones handled above will not go away by retrying.
+        if (result == CURLE_HTTP_RETURNED_ERROR)
+        {
+            error("Failed to download " + request.url + ": HTTP " + std::to_string(status));
+            return false;
+        }
+
+        std::clog << "Download interrupted (" << curl_easy_strerror(result) << ") after " << delivered
+                  << " bytes, retrying: " << request.url << std::endl;
+    }
+
+    error("Failed to download " + request.url + " after " + std::to_string(retries + 1) + " attempts.");
+    return false;
+}
+
+void DownloadCache::prepare(FetchManager::Request &request) const
+{
+    std::error_code ec;
+    auto known = storedETag();
+
+    if (std::filesystem::exists(body, ec) && !known.empty()) request.headers.push_back("If-None-Match: " + known);
+    else if (std::filesystem::exists(part, ec))
+    {
+        request.headers.push_back("Range: bytes=" + std::to_string(std::filesystem::file_size(part, ec)) + "-");
+        if (!known.empty()) request.headers.push_back("If-Range: " + known);
+    }
+}
+
+bool DownloadCache::complete(FetchManager::Response &response)
+{
+    std::error_code ec;
+    auto read = [](const std::filesystem::path &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<unsigned char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+
+    if (response.ok && response.status == 304)
+    {
+        std::filesystem::last_write_time(body, std::filesystem::file_time_type::clock::now(), ec);
+        response.body = read(body);
+        return true;
+    }
+
+    if (response.status == 416 && std::filesystem::exists(part, ec))
+    {
+        response.body = read(part);
+        commit(response.body.size());
+        return response.ok = true;
+    }
+
+    if (response.status != 200 && response.status != 206) return false;
+
+    // Keep whatever arrived, complete or not, so the next attempt only has to fetch the rest. A changed track makes the
+    // finished body stale even if this transfer did not complete.
+    auto prefix = response.status == 206 ? read(part) : std::vector<unsigned char>();
+    if (response.status == 200) std::filesystem::remove(body, ec);
+    storeETag(response.etag);
+
+    std::ofstream output(part, std::ios::binary | (response.status == 206 ? std::ios::app : std::ios::trunc));
+    output.write(reinterpret_cast<const char*>(response.body.data()), static_cast<long>(response.body.size()));
+    output.close();
+
+    response.body.insert(response.body.begin(), prefix.begin(), prefix.end());
+    if (!output)
+    {
+        // Say, a full disk: the bytes in memory are still good, they just are not cached.
+        std::clog << "Not caching download (" << strerror(errno) << "): " << part.string() << std::endl;
+        discard();
+        return response.ok;
+    }
+
+    if (!response.ok) return false;
+
+    commit(response.body.size());
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <functional>
+#include <filesystem>
+
+#include "fetch.h"
+
+// Exclusive lock on a download cache entry, held until destroyed. Entries are locked for as long as they are being
+// downloaded, so importers sharing the cache directory, in this process or another, never write one at the same time.
+class EntryLock
+{
+public:
+    explicit EntryLock(const std::filesystem::path &path);
+    EntryLock(EntryLock &&other) noexcept : fd(std::exchange(other.fd, -1)) {}
+    EntryLock(const EntryLock &) = delete;
+    EntryLock &operator=(const EntryLock &) = delete;
+    EntryLock &operator=(EntryLock &&) = delete;
+    ~EntryLock();
+
+private:
+    int fd;
+};
+
+// On-disk cache of remote downloads, keyed by URL. Interrupted transfers keep their partial body and are resumed with
+// a Range request; finished entries are revalidated with If-None-Match and served locally when the server answers
+// 304 Not Modified.
+class DownloadCache
+{
+public:
+    using Sink = std::function<bool(const unsigned char* bytes, size_t size)>;
+
+    explicit DownloadCache(const std::string &url);
+
+    // Streams the body into `sink`, retrying with Range requests after transfer errors. The sink sees every byte
+    // exactly once and in order, whether it comes from the cache or the network. Locks the entry while it runs.
+    bool fetch(const FetchManager::Request &request, const Sink &sink);
+
+    // Buffered variant for FetchManager: `prepare` adds the conditional headers, `complete` merges the response with
+    // the cached bytes so `response.body` always holds the whole file when it returns true. The caller holds lock().
+    void prepare(FetchManager::Request &request) const;
+    bool complete(FetchManager::Response &response);
+
+    [[nodiscard]] EntryLock lock() const { return EntryLock(lockFile); }
+
+    static std::filesystem::path directory();
+    // Waits before retry `attempt` (from 1), doubling from 250 ms up to 4 s.
+    static void backoff(int attempt);
+
+    // Set from the host's cache directory when the plugin is loaded.
+    static std::filesystem::path root;
+    static int retries;
+    static uintmax_t limit;
+
+private:
+    [[nodiscard]] std::string storedETag() const;
+    void storeETag(const std::string &etag) const;
+    // Promotes the part file to the finished body if it holds exactly `size` bytes, and discards it otherwise.
+    bool commit(uintmax_t size) const;
+    // Drops the partial body and its ETag, for when they can no longer be trusted.
+    void discard() const;
+    bool replay(const std::filesystem::path &path, uintmax_t from, uintmax_t to, const Sink &sink) const;
+
+    std::filesystem::path body, part, etag, lockFile;
+};
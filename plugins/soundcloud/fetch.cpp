@@ -0,0 +1,141 @@
+#include "fetch.h"
+
+#include <chrono>
+#include <memory>
+#include <strings.h>
+
+struct Transfer
+{
+    size_t index = 0;
+    CURL* curl = nullptr;
+    curl_slist* headers = nullptr;
+    FetchManager::Response response;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    char error[CURL_ERROR_SIZE] = {};
+};
+
+FetchManager::FetchManager(unsigned int concurrency) : multi(curl_multi_init()), concurrency(std::max(concurrency, 1u))
+{
+    share();
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(this->concurrency));
+}
+
+FetchManager::~FetchManager() { curl_multi_cleanup(multi); }
+
+CURLSH* FetchManager::share()
+{
+    static std::mutex locks[CURL_LOCK_DATA_LAST];
+    static CURLSH* handle = []
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+
+        auto handle = curl_share_init();
+        curl_share_setopt(handle, CURLSHOPT_LOCKFUNC, static_cast<curl_lock_function>(
+            [](CURL*, curl_lock_data data, curl_lock_access, void*) { locks[data].lock(); }));
+        curl_share_setopt(handle, CURLSHOPT_UNLOCKFUNC, static_cast<curl_unlock_function>(
+            [](CURL*, curl_lock_data data, void*) { locks[data].unlock(); }));
+
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        return handle;
+    }();
+
+    return handle;
+}
+
+void FetchManager::configure(CURL* curl)
+{
+    curl_easy_setopt(curl, CURLOPT_SHARE, share());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+}
+
+size_t FetchManager::captureETag(char* buffer, size_t size, size_t nitems, void* etag)
+{
+    std::string line(buffer, size * nitems);
+    auto &value = *static_cast<std::string*>(etag);
+
+    // Every response in a redirect chain starts with a status line; only the final response's ETag counts.
+    if (line.starts_with("HTTP/")) value.clear();
+    else if (line.size() > 5 && strncasecmp(line.c_str(), "etag:", 5) == 0)
+    {
+        value = line.substr(5);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+    }
+
+    return size * nitems;
+}
+
+void FetchManager::run(const std::vector<Request> &requests, const Callback &done)
+{
+    curl_write_callback write = [](char* ptr, size_t size, size_t nmemb, void* userdata) -> size_t
+    {
+        auto &body = static_cast<Transfer*>(userdata)->response.body;
+        body.insert(body.end(), ptr, ptr + size * nmemb);
+        return size * nmemb;
+    };
+
+    size_t next = 0, active = 0;
+    auto start = [&]
+    {
+        auto transfer = new Transfer;
+        transfer->index = next;
+        transfer->curl = curl_easy_init();
+
+        for (auto &header: requests[next].headers) transfer->headers = curl_slist_append(transfer->headers,
+                                                                                         header.c_str());
+
+        configure(transfer->curl);
+        curl_easy_setopt(transfer->curl, CURLOPT_URL, requests[next].url.c_str());
+        curl_easy_setopt(transfer->curl, CURLOPT_HTTPHEADER, transfer->headers);
+        curl_easy_setopt(transfer->curl, CURLOPT_WRITEFUNCTION, write);
+        curl_easy_setopt(transfer->curl, CURLOPT_WRITEDATA, transfer);
+        curl_easy_setopt(transfer->curl, CURLOPT_HEADERFUNCTION, captureETag);
+        curl_easy_setopt(transfer->curl, CURLOPT_HEADERDATA, &transfer->response.etag);
+        curl_easy_setopt(transfer->curl, CURLOPT_ERRORBUFFER, transfer->error);
+        curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+
+        curl_multi_add_handle(multi, transfer->curl);
+        ++next;
+        ++active;
+    };
+
+    while (next < requests.size() && active < concurrency) start();
+
+    while (active)
+    {
+        int running = 0, queued = 0;
+        curl_multi_perform(multi, &running);
+
+        while (auto message = curl_multi_info_read(multi, &queued))
+        {
+            if (message->msg != CURLMSG_DONE) continue;
+
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+            std::unique_ptr<Transfer> owner(transfer);
+
+            auto &response = transfer->response;
+            curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response.status);
+            response.ok = message->data.result == CURLE_OK;
+            if (!response.ok)
+                response.error = *transfer->error ? transfer->error : curl_easy_strerror(message->data.result);
+            response.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                             transfer->start).count();
+
+            curl_multi_remove_handle(multi, transfer->curl);
+            curl_easy_cleanup(transfer->curl);
+            curl_slist_free_all(transfer->headers);
+            --active;
+
+            if (next < requests.size()) start();
+            done(transfer->index, std::move(response));
+        }
+
+        if (active) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+
+#include <curl/curl.h>
+
+// Downloads many URLs concurrently on one curl multi handle. Every transfer, including single-track imports that use
+// their own easy handle, goes through a process-wide CURLSH so TCP/TLS connections, DNS lookups and TLS sessions are
+// reused instead of paying a fresh handshake per track.
+class FetchManager
+{
+public:
+    struct Request
+    {
+        std::string url;
+        std::vector<std::string> headers;
+    };
+
+    struct Response
+    {
+        bool ok = false;
+        long status = 0;
+        std::string error, etag;
+        std::vector<unsigned char> body;
+        double seconds = 0;
+    };
+
+    using Callback = std::function<void(size_t index, Response &&response)>;
+
+    explicit FetchManager(unsigned int concurrency);
+    FetchManager(const FetchManager &) = delete;
+    FetchManager &operator=(const FetchManager &) = delete;
+    ~FetchManager();
+
+    // Runs every request, at most `concurrency` at a time, and calls `done` on this thread as each one finishes.
+    void run(const std::vector<Request> &requests, const Callback &done);
+
+    static void configure(CURL* curl);
+    static size_t captureETag(char* buffer, size_t size, size_t nitems, void* etag);
+
+private:
+    static CURLSH* share();
+
+    CURLM* multi;
+    unsigned int concurrency;
+};
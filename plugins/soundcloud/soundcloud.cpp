@@ -0,0 +1,113 @@
+#include <map>
+#include <numeric>
+
+#include "download.h"
+#include "include/plugin.h"
+#include "include/utils.h"
+
+static FetchManager::Request soundCloudRequest(const std::string &id)
+{
+    auto baseURL = getenv("SOUNDCLOUD_API_URL");
+    return {std::string(baseURL && *baseURL ? baseURL : "https://api.soundcloud.com") + "/tracks/" + id + "/download",
+            {"Authorization: OAuth " + std::string(SOUNDCLOUD_API_KEY)}};
+}
+
+// A single track is streamed into its sink as it arrives, so decoding overlaps the download; the download cache keeps
+// a copy so an interrupted transfer can resume and an unchanged track is not downloaded again.
+static bool fetchTrack(const std::string &id, const SoundTestSink &sink)
+{
+    auto request = soundCloudRequest(id);
+    DownloadCache cache(request.url);
+    return cache.fetch(request, [&sink](const unsigned char* bytes, size_t size)
+    {
+        return sink.write(sink.context, bytes, size) != 0;
+    });
+}
+
+// Several tracks share connections on one thread and each body is handed over whole as soon as it completes.
+// Interrupted tracks are retried and resume from the bytes the download cache kept.
+static size_t fetchTracks(const std::vector<std::string> &tracks, const SoundTestSink* sinks, int* ok)
+{
+    // A track listed twice is downloaded once. The map keeps ids sorted, so every process locks entries in the same
+    // order and two overlapping playlists cannot deadlock.
+    std::map<std::string, std::vector<size_t>> positions;
+    for (size_t i = 0; i < tracks.size(); ++i) positions[tracks[i]].push_back(i);
+
+    std::vector<std::string> ids;
+    std::vector<DownloadCache> caches;
+    std::vector<EntryLock> locks;
+    for (auto &[id, indices]: positions)
+    {
+        ids.push_back(id);
+        caches.emplace_back(soundCloudRequest(id).url);
+        locks.push_back(caches.back().lock());
+    }
+
+    size_t fetched = 0;
+    std::vector<size_t> pending(ids.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    FetchManager fetcher(SOUNDCLOUD_CONCURRENCY);
+
+    for (int attempt = 0; attempt <= DownloadCache::retries && !pending.empty(); ++attempt)
+    {
+        if (attempt > 0) DownloadCache::backoff(attempt);
+
+        std::vector<FetchManager::Request> requests;
+        for (auto i: pending)
+        {
+            requests.push_back(soundCloudRequest(ids[i]));
+            caches[i].prepare(requests.back());
+        }
+
+        std::vector<size_t> retry;
+        fetcher.run(requests, [&](size_t index, FetchManager::Response &&response)
+        {
+            auto i = pending[index];
+            if (!caches[i].complete(response))
+            {
+                if (response.status >= 400) error("Failed to download SoundCloud track " + ids[i] + ": " +
+                                                  response.error);
+                else retry.push_back(i);
+                return;
+            }
+
+            for (auto position: positions[ids[i]])
+            {
+                auto &sink = sinks[position];
+                ok[position] = sink.write(sink.context, response.body.data(), response.body.size()) != 0;
+                if (ok[position]) ++fetched;
+            }
+        });
+
+        pending = std::move(retry);
+    }
+
+    for (auto i: pending) error("Failed to download SoundCloud track " + ids[i] + " after " +
+                                std::to_string(DownloadCache::retries + 1) + " attempts.");
+    return fetched;
+}
+
+static const SoundTestPlugin plugin = {
+    SOUNDTEST_PLUGIN_ABI, "soundcloud",
+    nullptr, nullptr, nullptr, nullptr,
+    [](const char* const* ids, size_t count, const SoundTestSink* sinks, int* ok) -> size_t
+    {
+        std::fill(ok, ok + count, 0);
+        if (count == 1)
+        {
+            ok[0] = fetchTrack(ids[0], sinks[0]);
+            return ok[0];
+        }
+
+        return fetchTracks(std::vector<std::string>(ids, ids + count), sinks, ok);
+    }
+};
+
+extern "C" __attribute__((visibility("default"))) const SoundTestPlugin* soundtest_plugin(const SoundTestHost* host)
+{
+    static const SoundTestHost* current;
+    current = host;
+    errorHandler = [](const std::string &message) { current->error(message.c_str()); };
+    DownloadCache::root = host->cacheDirectory;
+    return &plugin;
+}
@@ -0,0 +1,408 @@
+#include "include/archive.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <functional>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "include/utils.h"
+
+static constexpr uint8_t BLOCK_ENTROPY_CODED = 1;
+static constexpr uint32_t RANS_PROB_BITS = 12, RANS_PROB_SCALE = 1 << RANS_PROB_BITS, RANS_LOWER_BOUND = 1 << 23;
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*&in, const uint8_t* end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7)
+    {
+        auto byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+static uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+static int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+static std::vector<uint8_t> encodeNotes(const std::pair<int, int>* notes, size_t count)
+{
+    std::vector<uint8_t> out;
+    putVarint(out, count);
+
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        putVarint(out, zigzag(notes[i].first - previous));
+        previous = notes[i].first;
+    }
+
+    for (size_t i = 0; i < count;)
+    {
+        size_t run = 1;
+        while (i + run < count && notes[i + run].second == notes[i].second) ++run;
+
+        putVarint(out, run);
+        putVarint(out, zigzag(notes[i].second));
+        i += run;
+    }
+
+    return out;
+}
+
+// Decodes one block, which must hold exactly `expected` notes.
+static bool decodeNotes(const uint8_t* in, const uint8_t* end, size_t expected,
+                        std::vector<std::pair<int, int>> &notes)
+{
+    uint64_t count = 0, value = 0;
+    if (!getVarint(in, end, count) || count != expected) return false;
+    notes.resize(count);
+
+    int64_t frequency = 0;
+    for (auto &note: notes)
+    {
+        if (!getVarint(in, end, value)) return false;
+        frequency += unzigzag(value);
+        note.first = static_cast<int>(frequency);
+    }
+
+    for (size_t i = 0; i < count;)
+    {
+        uint64_t run = 0;
+        if (!getVarint(in, end, run) || !getVarint(in, end, value) || run == 0 || run > count - i) return false;
+        for (auto duration = static_cast<int>(unzigzag(value)); run--; ++i) notes[i].second = duration;
+    }
+
+    return true;
+}
+
+static std::array<uint32_t, 256> normalizeFrequencies(const std::vector<uint8_t> &symbols)
+{
+    std::array<uint32_t, 256> counts = {}, frequencies = {};
+    for (auto symbol: symbols) ++counts[symbol];
+
+    uint32_t total = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (counts[s]) frequencies[s] = std::max<uint32_t>(1, static_cast<uint32_t>(
+            static_cast<uint64_t>(counts[s]) * RANS_PROB_SCALE / symbols.size()));
+        total += frequencies[s];
+    }
+
+    auto largest = std::max_element(frequencies.begin(), frequencies.end());
+    while (total > RANS_PROB_SCALE)
+    {
+        largest = std::max_element(frequencies.begin(), frequencies.end());
+        --*largest;
+        --total;
+    }
+
+    *largest += RANS_PROB_SCALE - total;
+    return frequencies;
+}
+
+static std::vector<uint8_t> ransEncode(const std::vector<uint8_t> &symbols)
+{
+    auto frequencies = normalizeFrequencies(symbols);
+    std::array<uint32_t, 256> cumulative = {};
+    for (int s = 1; s < 256; ++s) cumulative[s] = cumulative[s - 1] + frequencies[s - 1];
+
+    // rANS emits bytes last-to-first, so they are collected back to front and reversed at the end.
+    std::vector<uint8_t> reversed;
+    uint32_t state = RANS_LOWER_BOUND;
+    for (auto i = symbols.size(); i-- > 0;)
+    {
+        auto frequency = frequencies[symbols[i]];
+        auto limit = ((RANS_LOWER_BOUND >> RANS_PROB_BITS) << 8) * frequency;
+        while (state >= limit)
+        {
+            reversed.push_back(static_cast<uint8_t>(state));
+            state >>= 8;
+        }
+
+        state = (state / frequency << RANS_PROB_BITS) + state % frequency + cumulative[symbols[i]];
+    }
+
+    for (int i = 0; i < 4; ++i, state >>= 8) reversed.push_back(static_cast<uint8_t>(state));
+
+    std::vector<uint8_t> out;
+    out.push_back(static_cast<uint8_t>(std::count_if(frequencies.begin(), frequencies.end(),
+                                                     [](uint32_t f) { return f; }) - 1));
+    for (int s = 0; s < 256; ++s)
+        if (frequencies[s])
+        {
+            out.push_back(static_cast<uint8_t>(s));
+            putVarint(out, frequencies[s]);
+        }
+
+    out.insert(out.end(), reversed.rbegin(), reversed.rend());
+    return out;
+}
+
+static bool ransDecode(const uint8_t* in, const uint8_t* end, std::vector<uint8_t> &symbols)
+{
+    if (in >= end) return false;
+
+    std::array<uint32_t, 256> frequencies = {}, cumulative = {};
+    std::vector<uint8_t> lookup(RANS_PROB_SCALE);
+    uint32_t total = 0;
+
+    for (int used = *in++ + 1; used > 0; --used)
+    {
+        uint64_t frequency = 0;
+        if (in >= end) return false;
+        auto symbol = *in++;
+        if (!getVarint(in, end, frequency) || frequency > RANS_PROB_SCALE - total) return false;
+
+        frequencies[symbol] = static_cast<uint32_t>(frequency);
+        cumulative[symbol] = total;
+        std::fill(lookup.begin() + total, lookup.begin() + total + frequency, symbol);
+        total += static_cast<uint32_t>(frequency);
+    }
+
+    if (total != RANS_PROB_SCALE || end - in < 4) return false;
+
+    uint32_t state = 0;
+    for (int i = 0; i < 4; ++i) state = state << 8 | *in++;
+
+    for (auto &symbol: symbols)
+    {
+        auto slot = state & (RANS_PROB_SCALE - 1);
+        symbol = lookup[slot];
+        state = frequencies[symbol] * (state >> RANS_PROB_BITS) + slot - cumulative[symbol];
+        while (state < RANS_LOWER_BOUND && in < end) state = state << 8 | *in++;
+    }
+
+    return true;
+}
+
+bool ArchiveWriter::write(const std::vector<std::pair<int, int>> &data, const char* path, bool entropy)
+{
+    // Written under a private name and renamed over `path`, so a failed or interrupted write never replaces a good
+    // archive with a broken one.
+    auto temporary = std::string(path) + "." + std::to_string(getpid()) + "." +
+                     std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    if (!writeFile(data, temporary, entropy))
+    {
+        error("Failed to write file: " + temporary);
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    if (rename(temporary.c_str(), path) != 0)
+    {
+        error("Failed to replace " + std::string(path) + ": " + std::string(strerror(errno)));
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ArchiveWriter::writeFile(const std::vector<std::pair<int, int>> &data, const std::string &path, bool entropy)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    ArchiveHeader header = {};
+    std::memcpy(header.magic, ArchiveHeader::MAGIC, sizeof(header.magic));
+    header.version = ArchiveHeader::VERSION;
+    header.count = data.size();
+    header.blockSize = ArchiveHeader::BLOCK_SIZE;
+    header.blockCount = static_cast<uint32_t>((data.size() + header.blockSize - 1) / header.blockSize);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<ArchiveBlock> index;
+    int64_t start = 0;
+
+    for (size_t i = 0; i < data.size(); i += header.blockSize)
+    {
+        auto count = std::min<size_t>(header.blockSize, data.size() - i);
+        index.push_back({static_cast<uint64_t>(file.tellp()), start});
+        for (size_t j = i; j < i + count; ++j) start += data[j].second;
+
+        auto raw = encodeNotes(&data[i], count);
+        std::vector<uint8_t> block = {0};
+        putVarint(block, raw.size());
+
+        auto coded = entropy ? ransEncode(raw) : std::vector<uint8_t>();
+        if (entropy && coded.size() < raw.size())
+        {
+            block[0] = BLOCK_ENTROPY_CODED;
+            putVarint(block, coded.size());
+            block.insert(block.end(), coded.begin(), coded.end());
+        } else
+        {
+            putVarint(block, raw.size());
+            block.insert(block.end(), raw.begin(), raw.end());
+        }
+
+        file.write(reinterpret_cast<const char*>(block.data()), static_cast<long>(block.size()));
+    }
+
+    header.indexOffset = static_cast<uint64_t>(file.tellp());
+    file.write(reinterpret_cast<const char*>(index.data()), static_cast<long>(index.size() * sizeof(ArchiveBlock)));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    return !file.fail();
+}
+
+bool ArchiveReader::open(const char* path)
+{
+    file = std::ifstream(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, ArchiveHeader::MAGIC, sizeof(header.magic)) != 0)
+    {
+        error("Invalid note archive! Missing STNZ header.");
+        return false;
+    }
+    if (header.version != ArchiveHeader::VERSION || header.blockSize != ArchiveHeader::BLOCK_SIZE)
+    {
+        error("Unsupported note archive version! Found version " + std::to_string(header.version) + ".");
+        return false;
+    }
+    if (header.blockCount != (header.count + header.blockSize - 1) / header.blockSize)
+    {
+        error("Invalid note archive! Block count does not match note count.");
+        return false;
+    }
+
+    // The index has to fit in the file, so a forged block count cannot make the reader allocate more than the file
+    // holds.
+    struct stat status{};
+    if (stat(path, &status) != 0 || header.indexOffset < sizeof(ArchiveHeader) ||
+        header.indexOffset > static_cast<uint64_t>(status.st_size) ||
+        header.blockCount > (static_cast<uint64_t>(status.st_size) - header.indexOffset) / sizeof(ArchiveBlock))
+    {
+        error("Invalid note archive! Block index does not fit in the file.");
+        return false;
+    }
+
+    index.resize(header.blockCount);
+    file.seekg(static_cast<long>(header.indexOffset));
+    file.read(reinterpret_cast<char*>(index.data()), static_cast<long>(index.size() * sizeof(ArchiveBlock)));
+    if (!file)
+    {
+        error("Invalid note archive! Block index is truncated.");
+        return false;
+    }
+
+    currentBlock = SIZE_MAX;
+    return seek(0);
+}
+
+bool ArchiveReader::loadBlock(size_t block)
+{
+    if (block == currentBlock) return true;
+
+    uint8_t prefix[21] = {};
+    file.clear();
+    file.seekg(static_cast<long>(index[block].offset));
+    file.read(reinterpret_cast<char*>(prefix), sizeof(prefix));
+    file.clear();
+
+    const uint8_t* in = prefix + 1;
+    uint64_t rawSize = 0, storedSize = 0;
+    if (!getVarint(in, prefix + sizeof(prefix), rawSize) || !getVarint(in, prefix + sizeof(prefix), storedSize) ||
+        rawSize > 16 * ArchiveHeader::BLOCK_SIZE * 2 || storedSize > 2 * rawSize + 1024)
+    {
+        error("Invalid note archive! Corrupt block " + std::to_string(block) + ".");
+        return false;
+    }
+
+    std::vector<uint8_t> stored(storedSize), raw;
+    file.seekg(static_cast<long>(index[block].offset + static_cast<uint64_t>(in - prefix)));
+    file.read(reinterpret_cast<char*>(stored.data()), static_cast<long>(stored.size()));
+
+    auto valid = static_cast<bool>(file);
+    if (valid && prefix[0] & BLOCK_ENTROPY_CODED)
+    {
+        raw.resize(rawSize);
+        valid = ransDecode(stored.data(), stored.data() + stored.size(), raw);
+    } else raw = std::move(stored);
+
+    // Every block but the last is full; positions are computed from that, so a block of any other size is corrupt.
+    auto expected = std::min<size_t>(header.blockSize, header.count - block * header.blockSize);
+    if (!valid || !decodeNotes(raw.data(), raw.data() + raw.size(), expected, notes))
+    {
+        error("Invalid note archive! Corrupt block " + std::to_string(block) + ".");
+        return false;
+    }
+
+    currentBlock = block;
+    blockStart = block * header.blockSize;
+    return true;
+}
+
+bool ArchiveReader::seek(size_t note)
+{
+    if (note >= header.count)
+    {
+        currentBlock = SIZE_MAX;
+        blockStart = header.count;
+        cursor = 0;
+        notes.clear();
+
+        return note == header.count;
+    }
+
+    if (!loadBlock(note / header.blockSize)) return false;
+    cursor = note - blockStart;
+    return true;
+}
+
+bool ArchiveReader::seekTime(int64_t ms)
+{
+    if (index.empty()) return seek(0);
+
+    auto block = std::upper_bound(index.begin(), index.end(), ms,
+                                  [](int64_t time, const ArchiveBlock &entry) { return time < entry.start; });
+    auto blockIndex = static_cast<size_t>(std::max<long>(block - index.begin() - 1, 0));
+    if (!loadBlock(blockIndex)) return false;
+
+    auto time = index[blockIndex].start;
+    for (cursor = 0; cursor + 1 < notes.size() && time + notes[cursor].second <= ms; ++cursor)
+        time += notes[cursor].second;
+
+    return true;
+}
+
+bool ArchiveReader::next(std::pair<int, int> &note)
+{
+    if (cursor >= notes.size())
+    {
+        if (position() >= header.count || !seek(position())) return false;
+    }
+
+    note = notes[cursor++];
+    return true;
+}
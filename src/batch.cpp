@@ -0,0 +1,223 @@
+#include "include/batch.h"
+
+static bool isImportable(const std::filesystem::path &path)
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    return extension == ".wav" || extension == ".mid" || extension == ".midi" || extension == ".mp3" ||
+           extension == ".csv" || extension == ".stn" || extension == ".stz";
+}
+
+static std::string escapeJSON(const std::string &text)
+{
+    std::string escaped;
+    for (auto c: text)
+    {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<int>(c));
+            escaped += code;
+        } else escaped += c;
+    }
+
+    return escaped;
+}
+
+std::vector<std::pair<std::string, std::string>> BatchConverter::collect(const Options &options)
+{
+    std::vector<std::pair<std::string, std::string>> files;
+    std::error_code ec;
+
+    if (std::filesystem::is_directory(options.input, ec))
+    {
+        for (auto &entry: std::filesystem::recursive_directory_iterator(options.input, ec))
+            if (entry.is_regular_file(ec) && isImportable(entry.path()))
+                files.emplace_back(entry.path().string(),
+                                   std::filesystem::relative(entry.path(), options.input, ec).string());
+    } else
+    {
+        glob_t matches;
+        if (glob(options.input.c_str(), 0, nullptr, &matches) == 0)
+            for (size_t i = 0; i < matches.gl_pathc; ++i)
+            {
+                std::filesystem::path path(matches.gl_pathv[i]);
+                if (std::filesystem::is_regular_file(path, ec) && isImportable(path))
+                    files.emplace_back(path.string(), path.filename().string());
+            }
+
+        globfree(&matches);
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+const char* BatchConverter::extension(Format format)
+{
+    switch (format)
+    {
+        case Format::Binary:
+            return ".stn";
+        case Format::Archive:
+            return ".stz";
+        default:
+            return ".csv";
+    }
+}
+
+bool BatchConverter::parseFormat(const std::string &name, Format &format)
+{
+    if (name == "csv") format = Format::CSV;
+    else if (name == "bin") format = Format::Binary;
+    else if (name == "stz") format = Format::Archive;
+    else return false;
+
+    return true;
+}
+
+void BatchConverter::convert(const Options &options, Result &result)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+
+    result.bytes = std::filesystem::file_size(result.input, ec);
+    std::filesystem::create_directories(std::filesystem::path(result.output).parent_path(), ec);
+
+    std::vector<std::pair<int, int>> data;
+    result.ok = AudioManager::importFile(data, result.input.c_str());
+    result.notes = data.size();
+
+    if (result.ok)
+        switch (options.format)
+        {
+            case Format::CSV:
+                result.ok = AudioManager::exportCSV(data, result.output.c_str());
+                break;
+            case Format::Binary:
+                result.ok = AudioManager::exportBinary(data, result.output.c_str());
+                break;
+            case Format::Archive:
+                result.ok = AudioManager::exportArchive(data, result.output.c_str());
+                break;
+        }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool BatchConverter::run(const Options &options, std::ostream &report)
+{
+    auto files = collect(options);
+    auto jobs = std::max(options.jobs, 1u);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Result> results(files.size());
+    std::set<std::string> outputs;
+    {
+        // Each worker holds at most one decoded file, so the pool size also bounds memory use.
+        WorkerPool pool(jobs);
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            // The source extension stays in the name, so foo.wav and foo.mid do not convert to the same file.
+            auto output = std::filesystem::path(options.outputDir) / files[i].second;
+            output += extension(options.format);
+
+            results[i].input = files[i].first;
+            results[i].output = output.string();
+
+            // Globs name outputs after the file alone, so equally named files from different directories would still
+            // be written to one path at the same time; only the first of them is converted.
+            if (!outputs.insert(results[i].output).second)
+            {
+                error("Skipping " + results[i].input + ": another input is already converted to " + results[i].output);
+                continue;
+            }
+
+            pool.submit([&options, &result = results[i]] { convert(options, result); });
+        }
+
+        pool.wait();
+    }
+
+    writeReport(report, results, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                jobs);
+    return std::all_of(results.begin(), results.end(), [](const Result &result) { return result.ok; });
+}
+
+void BatchConverter::writeReport(std::ostream &report, const std::vector<Result> &results, double seconds,
+                                 unsigned int jobs)
+{
+    size_t failed = 0, bytes = 0, notes = 0;
+
+    report << "{\n  \"files\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        auto &result = results[i];
+        auto throughput = result.ok && result.seconds > 0 ? static_cast<double>(result.bytes) / 1e6 / result.seconds
+                                                          : 0;
+
+        report << (i ? ",\n" : "\n") << "    {\"input\": \"" << escapeJSON(result.input) << "\", \"output\": \""
+               << escapeJSON(result.output) << "\", \"ok\": " << (result.ok ? "true" : "false")
+               << ", \"bytes\": " << result.bytes << ", \"notes\": " << result.notes << ", \"seconds\": "
+               << result.seconds << ", \"mbPerSecond\": " << throughput << "}";
+
+        failed += !result.ok;
+        bytes += result.bytes;
+        notes += result.notes;
+    }
+
+    report << (results.empty() ? "" : "\n  ") << "],\n  \"totals\": {\"files\": " << results.size()
+           << ", \"succeeded\": " << results.size() - failed << ", \"failed\": " << failed << ", \"bytes\": "
+           << bytes << ", \"notes\": " << notes << ", \"jobs\": " << jobs << ", \"seconds\": " << seconds
+           << ", \"mbPerSecond\": " << (seconds > 0 ? static_cast<double>(bytes) / 1e6 / seconds : 0)
+           << ", \"filesPerSecond\": " << (seconds > 0 ? static_cast<double>(results.size()) / seconds : 0)
+           << "}\n}" << std::endl;
+}
+
+static int usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--batch <directory|glob> [--output <directory>] [--format csv|bin|stz] "
+                                         "[--jobs <count>] [--report <file>] [--no-cache]]" << std::endl;
+    return EXIT_FAILURE;
+}
+
+int BatchConverter::runCommandLine(int argc, char** argv)
+{
+    Options options;
+    std::string reportPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--no-cache")
+        {
+            ImportCache::enabled = false;
+            continue;
+        }
+
+        if (i + 1 >= argc) return usage(argv[0]);
+
+        if (arg == "--batch") options.input = argv[++i];
+        else if (arg == "--output") options.outputDir = argv[++i];
+        else if (arg == "--report") reportPath = argv[++i];
+        else if (arg == "--jobs") options.jobs = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--format")
+        {
+            if (!parseFormat(argv[++i], options.format)) return usage(argv[0]);
+        } else return usage(argv[0]);
+    }
+
+    if (options.input.empty()) return usage(argv[0]);
+    if (reportPath.empty()) return run(options, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    std::ofstream report(reportPath);
+    if (!report.is_open())
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return EXIT_FAILURE;
+    }
+
+    return run(options, report) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+#include "include/cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+
+#include <unistd.h>
+
+#include "include/hash.h"
+#include "include/notes.h"
+#include "include/waveform.h"
+#include "include/metrics.h"
+#include "include/utils.h"
+
+bool ImportCache::enabled = true;
+uintmax_t ImportCache::limit = 256ULL << 20;
+
+ImportCache::ImportCache(const char* path, const char* importer)
+{
+    if (!enabled) return;
+
+    Metrics::StageTimer timer(Metrics::READ);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return;
+
+    // Anything that changes the analysis output has to be part of the key.
+    Hash64 hash;
+    hash.update(std::string(importer) + '|' + std::to_string(CHUNK_SIZE) + '|' + std::to_string(THRESHOLD) + '|' +
+                std::to_string(ANALYSER_VERSION) + '|' + std::to_string(NoteFileHeader::VERSION) + '|');
+
+    std::vector<char> buffer(1 << 20);
+    while (file.read(buffer.data(), static_cast<long>(buffer.size())) || file.gcount() > 0)
+        hash.update(buffer.data(), static_cast<size_t>(file.gcount()));
+
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash.digest() << ".stn";
+    entry = directory() / name.str();
+}
+
+bool ImportCache::load(std::vector<std::pair<int, int>> &data) const
+{
+    std::error_code ec;
+    if (entry.empty() || !std::filesystem::exists(entry, ec)) return false;
+
+    Metrics::StageTimer timer(Metrics::READ);
+
+    NoteView view;
+    if (!view.open(entry.c_str())) return false;
+
+    // A waveform is only useful if it comes back together with the notes; otherwise decode again to rebuild it.
+    auto waveform = Waveform::current();
+    if (waveform && !waveform->load(std::filesystem::path(entry).replace_extension(".wave"))) return false;
+
+    auto offset = data.size();
+    data.resize(offset + view.size());
+    for (size_t i = 0; i < view.size(); ++i) data[offset + i] = view[i];
+
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+    std::clog << "Loaded " << view.size() << " notes from import cache " << entry.string() << std::endl;
+    return true;
+}
+
+void ImportCache::store(const std::vector<std::pair<int, int>> &data, size_t offset) const
+{
+    if (entry.empty()) return;
+
+    Metrics::StageTimer timer(Metrics::EMIT);
+    std::error_code ec;
+    std::filesystem::create_directories(entry.parent_path(), ec);
+
+    // Write to a private name first so concurrent importers never see a partial entry.
+    auto temporary = entry;
+    temporary += "." + std::to_string(getpid()) + "." +
+                 std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    std::vector<std::pair<int, int>> notes(data.begin() + static_cast<long>(offset), data.end());
+    if (!NoteView::write(notes, temporary.c_str()))
+    {
+        std::filesystem::remove(temporary, ec);
+        return;
+    }
+
+    if (auto waveform = Waveform::current(); waveform && !waveform->empty())
+    {
+        auto wave = std::filesystem::path(entry).replace_extension(".wave");
+        auto waveTemporary = temporary;
+        waveTemporary.replace_extension(".wave.tmp");
+        if (waveform->save(waveTemporary)) std::filesystem::rename(waveTemporary, wave, ec);
+        else std::filesystem::remove(waveTemporary, ec);
+    }
+
+    std::filesystem::rename(temporary, entry, ec);
+    if (ec) std::filesystem::remove(temporary, ec);
+
+    evict(entry.parent_path(), limit, ".stn");
+}
+
+std::filesystem::path ImportCache::root()
+{
+    auto cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome) return std::filesystem::path(cacheHome) / "soundtest";
+
+    auto home = getenv("HOME");
+    return std::filesystem::path(home && *home ? home : "/tmp") / ".cache" / "soundtest";
+}
+
+std::filesystem::path ImportCache::directory() { return root() / "imports"; }
@@ -0,0 +1,266 @@
+#include <mutex>
+#include <condition_variable>
+
+#include "include/soundtest.h"
+
+static int usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " --play <file> [--play <file>...] [--device <path>] [--start <note>] "
+                                         "[--budget <MiB>] [--tempo <factor>] [--transpose <semitones>] "
+                                         "[--realtime [--cpu <index>]]\n"
+              << "       " << program << " --batch <directory|glob> [--output <directory>] [--format csv|bin|stz] "
+                                         "[--jobs <count>] [--report <file>] [--no-cache]\n"
+              << "       " << program << " --attach <ring> [--device <path>] [--tempo <factor>] "
+                                         "[--transpose <semitones>] [--realtime [--cpu <index>]]\n"
+              << "       " << program << " --feed <file> --ring <ring>\n"
+              << "       " << program << " --daemon <socket> [--device <path>] [--realtime [--cpu <index>]]\n"
+              << "       " << program << " --socket <path> [--channel <id>] --enqueue <file> [--priority <0-255>] | "
+                                         "--alert <file> | --stop | --status" << std::endl;
+    return EXIT_FAILURE;
+}
+
+// Blocks SIGINT and SIGTERM so they are only delivered through a signalfd. Call before any thread is started so no
+// other thread receives them.
+static sigset_t blockStopSignals()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    return signals;
+}
+
+static bool hasMagic(const std::string &path, const char* magic)
+{
+    char bytes[4] = {};
+    std::ifstream file(path, std::ios::binary);
+    return file.read(bytes, sizeof(bytes)) && memcmp(bytes, magic, sizeof(bytes)) == 0;
+}
+
+static int play(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    std::string device = "/dev/console", ringName;
+    size_t start = 0, budget = Playlist::DEFAULT_BUDGET;
+    Player::RealTime realTime;
+    float tempo = 1.0f;
+    int transpose = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--no-cache")
+        {
+            ImportCache::enabled = false;
+            continue;
+        }
+        if (arg == "--realtime")
+        {
+            realTime.enabled = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) return usage(argv[0]);
+
+        if (arg == "--play") paths.emplace_back(argv[++i]);
+        else if (arg == "--attach") ringName = argv[++i];
+        else if (arg == "--device") device = argv[++i];
+        else if (arg == "--start") start = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--cpu") realTime.cpu = std::atoi(argv[++i]);
+        else if (arg == "--tempo") tempo = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--transpose") transpose = std::atoi(argv[++i]);
+        else if (arg == "--budget") budget = static_cast<size_t>(std::max(0, std::atoi(argv[++i]))) << 20;
+        else return usage(argv[0]);
+    }
+
+    if (paths.empty() == ringName.empty()) return usage(argv[0]);
+
+    // Ctrl+C or a kill is delivered to the playback loop, which silences the speaker before the program exits.
+    auto signals = blockStopSignals();
+
+    std::unique_ptr<Playlist> playlist;
+    NoteRing ring;
+    NoteView view;
+    ArchiveReader archive;
+    static std::mutex mutex;
+    static std::condition_variable changed;
+    Player player([]
+                  {
+                      // Taking the lock orders the notification after the waiter has checked playing().
+                      { std::lock_guard lock(mutex); }
+                      changed.notify_all();
+                  });
+    player.realTime = realTime;
+    player.setTempo(tempo);
+    player.setTranspose(transpose);
+    player.stopOnSignals(signals);
+
+    // A ring is played live as producers push to it. Several files play back to back as a playlist, loaded in the
+    // background while the previous ones play. A note file plays from its mapping and an archive is decoded as it
+    // plays; anything else is imported first.
+    if (!ringName.empty())
+    {
+        if (!ring.open(ringName) || !player.play(ring, device)) return EXIT_FAILURE;
+    }
+    else if (paths.size() > 1)
+    {
+        playlist = std::make_unique<Playlist>(budget);
+        for (auto &path: paths) playlist->add(path);
+        if (!player.play(*playlist, device)) return EXIT_FAILURE;
+    }
+    else if (hasMagic(paths[0], NoteFileHeader::MAGIC))
+    {
+        if (!view.open(paths[0].c_str()) || !player.play(view, start, device)) return EXIT_FAILURE;
+    }
+    else if (hasMagic(paths[0], ArchiveHeader::MAGIC))
+    {
+        if (!archive.open(paths[0].c_str()) || !player.play(archive, start, device)) return EXIT_FAILURE;
+    }
+    else
+    {
+        std::vector<std::pair<int, int>> data;
+        if (!AudioManager::importFile(data, paths[0].c_str())) return EXIT_FAILURE;
+        if (!player.play(NoteSequence(data), start, device)) return EXIT_FAILURE;
+    }
+
+    std::unique_lock lock(mutex);
+    changed.wait(lock, [&player] { return !player.playing(); });
+    if (ring.isOpen())
+    {
+        std::clog << ring.overruns() << " overruns, " << ring.underruns() << " underruns" << std::endl;
+        NoteRing::unlink(ringName);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Pushes a file's notes into a ring, never more than fit, so a song longer than the ring is fed as it plays.
+static int feed(int argc, char** argv)
+{
+    std::string path, ringName;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        if (arg == "--feed") path = argv[i + 1];
+        else if (arg == "--ring") ringName = argv[i + 1];
+        else return usage(argv[0]);
+    }
+
+    std::vector<std::pair<int, int>> data;
+    NoteRing ring;
+    if (path.empty() || ringName.empty()) return usage(argv[0]);
+    if (!AudioManager::importFile(data, path.c_str()) || !ring.open(ringName)) return EXIT_FAILURE;
+
+    std::vector<NoteEvent> events;
+    for (auto [frequency, duration]: data) events.push_back({frequency, duration});
+
+    for (size_t sent = 0; sent < events.size();)
+    {
+        auto space = ring.capacity() - ring.size();
+        if (space == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        sent += ring.push(events.data() + sent, std::min(space, events.size() - sent));
+    }
+
+    ring.finish();
+    return EXIT_SUCCESS;
+}
+
+static int serve(int argc, char** argv)
+{
+    std::string socketPath, device = "/dev/console";
+    Player::RealTime realTime;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--realtime")
+        {
+            realTime.enabled = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) return usage(argv[0]);
+
+        if (arg == "--daemon") socketPath = argv[++i];
+        else if (arg == "--device") device = argv[++i];
+        else if (arg == "--cpu") realTime.cpu = std::atoi(argv[++i]);
+        else return usage(argv[0]);
+    }
+
+    if (socketPath.empty()) return usage(argv[0]);
+    if (!Player::ConsoleSink(device).ready()) return EXIT_FAILURE;
+
+    auto signals = blockStopSignals();
+    Daemon server([device] { return std::make_unique<Player::ConsoleSink>(device); });
+    server.realTime() = realTime;
+    return server.run(socketPath, signals) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int request(int argc, char** argv)
+{
+    std::string socketPath, path;
+    auto command = DaemonRequest::STATUS;
+    uint8_t priority = 0;
+    uint16_t channel = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--stop" || arg == "--status")
+        {
+            command = arg == "--stop" ? DaemonRequest::STOP : DaemonRequest::STATUS;
+            continue;
+        }
+
+        if (i + 1 >= argc) return usage(argv[0]);
+
+        if (arg == "--socket") socketPath = argv[++i];
+        else if (arg == "--enqueue" || arg == "--alert")
+        {
+            command = arg == "--alert" ? DaemonRequest::ALERT : DaemonRequest::ENQUEUE;
+            path = argv[++i];
+        }
+        else if (arg == "--priority") priority = static_cast<uint8_t>(std::clamp(std::atoi(argv[++i]), 0, 255));
+        else if (arg == "--channel") channel = static_cast<uint16_t>(std::clamp(std::atoi(argv[++i]), 0, 65535));
+        else return usage(argv[0]);
+    }
+
+    if (socketPath.empty()) return usage(argv[0]);
+
+    std::vector<std::pair<int, int>> data;
+    if (!path.empty() && !AudioManager::importFile(data, path.c_str())) return EXIT_FAILURE;
+
+    DaemonStatus status;
+    if (!Daemon::request(socketPath, command, priority, channel, data, status)) return EXIT_FAILURE;
+
+    const char* states[] = {"idle", "playing", "alerting"};
+    std::cout << states[std::min<size_t>(status.state, 2)] << ", note " << status.note << " at " << status.frequency
+              << " Hz, " << status.queued << " queued, " << status.clients << " connected" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    TRACE_THREAD("main");
+
+    auto has = [&](const char* flag)
+    {
+        return std::any_of(argv + 1, argv + argc, [flag](const char* arg) { return strcmp(arg, flag) == 0; });
+    };
+
+    int result;
+    if (has("--daemon")) result = serve(argc, argv);
+    else if (has("--socket")) result = request(argc, argv);
+    else if (has("--feed")) result = feed(argc, argv);
+    else if (has("--play") || has("--attach")) result = play(argc, argv);
+    else if (has("--batch")) result = BatchConverter::runCommandLine(argc, argv);
+    else result = usage(argv[0]);
+
+    Trace::flush();
+    return result;
+}
@@ -0,0 +1,426 @@
+#include "include/daemon.h"
+#include "include/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static bool address(const std::string &path, sockaddr_un &result)
+{
+    result = {};
+    result.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(result.sun_path))
+    {
+        error("Socket path is too long: " + path);
+        return false;
+    }
+
+    memcpy(result.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static void watch(int poll, int fd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(poll, EPOLL_CTL_ADD, fd, &event);
+}
+
+Daemon::Daemon(SinkFactory makeSink)
+        : makeSink(std::move(makeSink)), player([this]
+                                                {
+                                                    uint64_t one = 1;
+                                                    [[maybe_unused]] auto written = write(notifyFd, &one, sizeof(one));
+                                                }),
+          notifyFd(check(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))) {}
+
+Daemon::~Daemon()
+{
+    player.stop();
+    for (auto &connection: connections) close(connection.fd);
+    if (listenFd >= 0) close(listenFd);
+    if (pollFd >= 0) close(pollFd);
+    close(notifyFd);
+}
+
+bool Daemon::run(const std::string &socketPath, const sigset_t &signals)
+{
+    sockaddr_un local;
+    if (!address(socketPath, local)) return false;
+
+    // Only a socket is ever replaced, and only one nobody answers on: that is left over from a daemon that died, while
+    // one that answers (or that we may not even try) belongs to a live one. Anything else at the path is not ours.
+    struct stat existing{};
+    if (lstat(socketPath.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))
+        {
+            error(socketPath + " exists and is not a socket; refusing to replace it.");
+            return false;
+        }
+
+        auto probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        auto stale = connect(probe, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 && errno == ECONNREFUSED;
+        close(probe);
+        if (!stale)
+        {
+            error("Another daemon is already listening on " + socketPath);
+            return false;
+        }
+
+        unlink(socketPath.c_str());
+    }
+    else if (errno != ENOENT)
+    {
+        error("Failed to inspect " + socketPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Owner and group may queue sounds; grant access to other services through the group. The mode is set through the
+    // umask so the socket never exists with wider permissions, not even between bind() and a chmod().
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    auto mask = umask(0117);
+    auto bound = listenFd >= 0 && bind(listenFd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == 0;
+    auto bindError = errno;
+    umask(mask);
+    if (!bound || listen(listenFd, SOMAXCONN) != 0)
+    {
+        error("Failed to listen on " + socketPath + ": " + std::string(strerror(bound ? errno : bindError)));
+        return false;
+    }
+
+    auto signalFd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    pollFd = check(epoll_create1(EPOLL_CLOEXEC));
+    watch(pollFd, listenFd);
+    watch(pollFd, notifyFd);
+    if (signalFd >= 0) watch(pollFd, signalFd);
+
+    std::clog << "Listening on " << socketPath << std::endl;
+
+    for (bool running = true; running;)
+    {
+        epoll_event events[16];
+        auto count = epoll_wait(pollFd, events, 16, -1);
+        if (count < 0 && errno != EINTR)
+        {
+            error("Daemon loop failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        for (int e = 0; e < count; ++e)
+        {
+            auto fd = events[e].data.fd;
+            if (fd == signalFd) running = false;
+            else if (fd == listenFd) while (accept());
+            else if (fd == notifyFd)
+            {
+                uint64_t value;
+                [[maybe_unused]] auto drained = read(notifyFd, &value, sizeof(value));
+            }
+            else
+            {
+                auto connection = std::find_if(connections.begin(), connections.end(),
+                                               [fd](auto &c) { return c.fd == fd; });
+                if (connection == connections.end() || receive(*connection)) continue;
+
+                close(fd);
+                connections.erase(connection);
+            }
+        }
+
+        schedule();
+    }
+
+    player.stop();
+    if (signalFd >= 0) close(signalFd);
+    unlink(socketPath.c_str());
+    return true;
+}
+
+bool Daemon::accept()
+{
+    auto fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return false;
+
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    if (connections.size() >= MAX_CLIENTS || getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    connections.push_back({fd, credentials.uid, {}});
+    watch(pollFd, fd);
+    return true;
+}
+
+bool Daemon::receive(Connection &connection)
+{
+    // At most one buffer per wakeup, and nothing more once the largest possible request is waiting. Level-triggered
+    // epoll brings the loop back for the rest, so a client that keeps writing can neither grow `input` without bound
+    // nor hold the loop while alerts from other clients wait.
+    constexpr size_t MAX_REQUEST = sizeof(DaemonRequest) + DaemonRequest::MAX_NOTES * 2 * sizeof(int32_t);
+    uint8_t buffer[65536];
+    if (connection.input.size() < MAX_REQUEST)
+    {
+        auto received = read(connection.fd, buffer, std::min(sizeof(buffer), MAX_REQUEST - connection.input.size()));
+        if (received == 0) return false;
+        if (received < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        if (received > 0) connection.input.insert(connection.input.end(), buffer, buffer + received);
+    }
+
+    size_t offset = 0;
+    while (connection.input.size() - offset >= sizeof(DaemonRequest))
+    {
+        DaemonRequest header;
+        memcpy(&header, connection.input.data() + offset, sizeof(header));
+        if (memcmp(header.magic, DaemonRequest::MAGIC, sizeof(header.magic)) != 0 ||
+            header.count > DaemonRequest::MAX_NOTES)
+        {
+            reply(connection, DaemonStatus::REJECTED);
+            return false;
+        }
+
+        auto carriesNotes = header.command == DaemonRequest::ENQUEUE || header.command == DaemonRequest::ALERT;
+        auto size = sizeof(header) + (carriesNotes ? header.count * 2 * sizeof(int32_t) : 0);
+        if (connection.input.size() - offset < size) break;
+
+        if (!handle(connection, header, connection.input.data() + offset + sizeof(header))) return false;
+        offset += size;
+    }
+
+    connection.input.erase(connection.input.begin(), connection.input.begin() + static_cast<long>(offset));
+    return true;
+}
+
+bool Daemon::handle(Connection &connection, const DaemonRequest &header, const uint8_t* payload)
+{
+    auto owner = static_cast<uint64_t>(connection.uid) << 16 | header.channel;
+    auto queue = std::find_if(queues.begin(), queues.end(), [owner](auto &q) { return q.owner == owner; });
+
+    switch (header.command)
+    {
+        case DaemonRequest::ENQUEUE:
+        case DaemonRequest::ALERT:
+        {
+            // Every job costs at least its own size, so empty sequences cannot fill the daemon either.
+            auto cost = sizeof(Job) + header.count * sizeof(std::pair<int, int>);
+            auto user = userBytes.find(connection.uid);
+            auto used = user != userBytes.end() ? user->second : 0;
+            if ((header.command == DaemonRequest::ENQUEUE && queue != queues.end() &&
+                 queue->jobs.size() >= MAX_QUEUED) || used + cost > USER_BUDGET || totalBytes + cost > TOTAL_BUDGET)
+            {
+                reply(connection, DaemonStatus::REJECTED);
+                return true;
+            }
+
+            std::vector<std::pair<int, int>> notes(header.count);
+            for (uint32_t i = 0; i < header.count; ++i)
+            {
+                int32_t note[2];
+                memcpy(note, payload + i * sizeof(note), sizeof(note));
+                notes[i] = {std::max(0, note[0]), std::max(0, note[1])};
+            }
+
+            Job job{NoteSequence(notes), owner, header.priority, 0, Charge(this, connection.uid, cost)};
+            if (header.command == DaemonRequest::ALERT) alerts.push_back(std::move(job));
+            else
+            {
+                if (queue == queues.end()) queue = queues.insert(queues.end(), {owner, {}});
+                queue->jobs.push_back(std::move(job));
+            }
+            break;
+        }
+        case DaemonRequest::STOP:
+            if (queue != queues.end()) queues.erase(queue);
+            stopOwnedBy(owner);
+            break;
+        case DaemonRequest::STATUS:
+            break;
+        default:
+            reply(connection, DaemonStatus::REJECTED);
+            return false;
+    }
+
+    // Alerts start before the reply goes out, so they never wait on the client.
+    schedule();
+    reply(connection, DaemonStatus::OK);
+    return true;
+}
+
+Daemon::Charge::Charge(Daemon* daemon, uid_t uid, size_t bytes) : daemon(daemon), uid(uid), bytes(bytes)
+{
+    daemon->userBytes[uid] += bytes;
+    daemon->totalBytes += bytes;
+}
+
+Daemon::Charge::Charge(Charge &&other) noexcept
+        : daemon(std::exchange(other.daemon, nullptr)), uid(other.uid), bytes(other.bytes) {}
+
+Daemon::Charge &Daemon::Charge::operator=(Charge &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    this->~Charge();
+    daemon = std::exchange(other.daemon, nullptr);
+    uid = other.uid;
+    bytes = other.bytes;
+    return *this;
+}
+
+Daemon::Charge::~Charge()
+{
+    if (!daemon) return;
+
+    auto user = daemon->userBytes.find(uid);
+    if ((user->second -= bytes) == 0) daemon->userBytes.erase(user);
+    daemon->totalBytes -= bytes;
+}
+
+void Daemon::reply(Connection &connection, DaemonStatus::Result result)
+{
+    size_t queued = alerts.size() + (interrupted ? 1 : 0);
+    for (auto &queue: queues) queued += queue.jobs.size();
+
+    DaemonStatus status{};
+    memcpy(status.magic, DaemonRequest::MAGIC, sizeof(status.magic));
+    status.result = result;
+    status.state = !playing ? DaemonStatus::IDLE : alerting ? DaemonStatus::ALERTING : DaemonStatus::PLAYING;
+    status.clients = static_cast<uint16_t>(connections.size());
+    status.queued = static_cast<uint32_t>(queued);
+    auto note = player.note();
+    status.note = playing && note != SIZE_MAX ? static_cast<uint32_t>(note) : 0;
+    status.frequency = player.frequency();
+
+    // A client that does not read its replies loses them rather than stalling the daemon.
+    [[maybe_unused]] auto written = send(connection.fd, &status, sizeof(status), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void Daemon::stopOwnedBy(uint64_t owner)
+{
+    alerts.erase(std::remove_if(alerts.begin(), alerts.end(), [owner](auto &job) { return job.owner == owner; }),
+                 alerts.end());
+    if (interrupted && interrupted->owner == owner) interrupted.reset();
+    if (playing && playing->owner == owner)
+    {
+        player.stop();
+        playing.reset();
+        alerting = false;
+    }
+}
+
+void Daemon::schedule()
+{
+    if (playing && !player.playing())
+    {
+        playing.reset();
+        alerting = false;
+    }
+
+    if (!alerts.empty())
+    {
+        if (alerting) return;
+
+        // Preempt a queued sequence, keeping its place so it picks up where the alert cut in.
+        if (playing)
+        {
+            playing->start = std::min(player.note(), playing->notes.size());
+            interrupted = std::move(playing);
+        }
+
+        auto job = std::move(alerts.front());
+        alerts.pop_front();
+        play(std::move(job), true);
+        return;
+    }
+
+    if (playing) return;
+    if (interrupted)
+    {
+        auto job = std::move(*interrupted);
+        interrupted.reset();
+        play(std::move(job), false);
+        return;
+    }
+
+    // Highest priority first; among queues with equal priority, the one that has waited longest for its turn.
+    auto next = queues.end();
+    for (auto queue = queues.begin(); queue != queues.end(); ++queue)
+        if (next == queues.end() || queue->jobs.front().priority > next->jobs.front().priority) next = queue;
+    if (next == queues.end()) return;
+
+    auto served = std::move(*next);
+    queues.erase(next);
+    play(std::move(served.jobs.front()), false);
+    served.jobs.pop_front();
+    if (!served.jobs.empty()) queues.push_back(std::move(served));
+}
+
+void Daemon::play(Job &&job, bool alert)
+{
+    playing = std::make_unique<Job>(std::move(job));
+    alerting = alert;
+    player.play(playing->notes, playing->start, makeSink());
+}
+
+bool Daemon::request(const std::string &socketPath, DaemonRequest::Command command, uint8_t priority,
+                     uint16_t channel, const std::vector<std::pair<int, int>> &notes, DaemonStatus &status)
+{
+    sockaddr_un remote;
+    if (!address(socketPath, remote)) return false;
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0)
+    {
+        error("Failed to connect to " + socketPath + ": " + std::string(strerror(errno)));
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    auto carriesNotes = command == DaemonRequest::ENQUEUE || command == DaemonRequest::ALERT;
+    DaemonRequest header{};
+    memcpy(header.magic, DaemonRequest::MAGIC, sizeof(header.magic));
+    header.command = command;
+    header.priority = priority;
+    header.channel = channel;
+    header.count = carriesNotes ? static_cast<uint32_t>(notes.size()) : 0;
+
+    std::vector<uint8_t> message(sizeof(header) + header.count * 2 * sizeof(int32_t));
+    memcpy(message.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < header.count; ++i)
+    {
+        int32_t note[2] = {notes[i].first, notes[i].second};
+        memcpy(message.data() + sizeof(header) + i * sizeof(note), note, sizeof(note));
+    }
+
+    auto ok = true;
+    for (size_t sent = 0; ok && sent < message.size();)
+    {
+        auto written = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        ok = written > 0;
+        if (ok) sent += static_cast<size_t>(written);
+    }
+
+    for (size_t received = 0; ok && received < sizeof(status);)
+    {
+        auto count = recv(fd, reinterpret_cast<uint8_t*>(&status) + received, sizeof(status) - received, 0);
+        if (count < 0 && errno == EINTR) continue;
+        ok = count > 0;
+        if (ok) received += static_cast<size_t>(count);
+    }
+
+    close(fd);
+    if (!ok) error("Daemon request failed: " + std::string(errno ? strerror(errno) : "connection closed"));
+    else if (status.result != DaemonStatus::OK) error("The daemon rejected the request.");
+    return ok && status.result == DaemonStatus::OK;
+}
@@ -0,0 +1,55 @@
+#include "include/decoder.h"
+
+#include "include/metrics.h"
+
+DecoderStream::DecoderStream(const SoundTestPlugin* plugin, std::vector<std::pair<int, int>> &data)
+        : plugin(plugin), data(data)
+{
+    if (!plugin || !plugin->open) return;
+
+    SoundTestSink sink = {this, format, write};
+    decoder = plugin->open(&sink);
+}
+
+DecoderStream::~DecoderStream()
+{
+    if (decoder) plugin->close(decoder);
+}
+
+void DecoderStream::format(void* context, long rate)
+{
+    auto stream = static_cast<DecoderStream*>(context);
+    if (stream->analyser) stream->analyser->finish();
+    stream->analyser = std::make_unique<Analyser>(stream->data, rate);
+}
+
+int DecoderStream::write(void* context, const void* pcm, size_t size)
+{
+    auto stream = static_cast<DecoderStream*>(context);
+    if (!stream->analyser) return 0;
+
+    Metrics::StageTimer timer(Metrics::ANALYSE);
+    auto samples = static_cast<const short*>(pcm);
+    for (size_t i = 0; i < size / sizeof(short); ++i) stream->analyser->push(samples[i]);
+    return 1;
+}
+
+bool DecoderStream::feed(const unsigned char* bytes, size_t size)
+{
+    if (!decoder) return false;
+
+    Metrics::StageTimer timer(Metrics::DECODE);
+    if (plugin->feed(decoder, bytes, size)) return true;
+
+    plugin->close(decoder);
+    decoder = nullptr;
+    return false;
+}
+
+bool DecoderStream::finish()
+{
+    if (!decoder || !plugin->finish(decoder)) return false;
+
+    if (analyser) analyser->finish();
+    return true;
+}
@@ -0,0 +1,43 @@
+#include "include/cache.h"
+
+#include <algorithm>
+#include <map>
+
+// Kept apart from the rest of ImportCache so plugins with their own caches can share it without the note formats.
+void ImportCache::evict(const std::filesystem::path &directory, uintmax_t limit, const char* extension)
+{
+    // Side files (waveforms, ETags) share their entry's stem and are evicted together with it.
+    std::map<std::string, std::pair<std::filesystem::file_time_type, uintmax_t>> entries;
+    std::error_code ec;
+    uintmax_t total = 0;
+
+    for (auto &file: std::filesystem::directory_iterator(directory, ec))
+    {
+        // Temporaries are still being written, and lock files must outlive the entries they guard.
+        if (file.path().extension() == ".tmp" || file.path().extension() == ".lock") continue;
+
+        auto size = file.file_size(ec);
+        auto &entry = entries[file.path().stem().string()];
+
+        total += size;
+        entry.second += size;
+        if (file.path().extension() == extension) entry.first = file.last_write_time(ec);
+    }
+
+    if (total <= limit) return;
+
+    // Hits refresh the modification time, so the oldest entries are the least recently used.
+    std::vector<std::pair<std::filesystem::file_time_type, std::string>> order;
+    for (auto &[stem, entry]: entries) order.emplace_back(entry.first, stem);
+    std::sort(order.begin(), order.end());
+
+    for (auto &[time, stem]: order)
+    {
+        if (total <= limit) break;
+
+        for (auto &file: std::filesystem::directory_iterator(directory, ec))
+            if (file.path().stem() == stem) std::filesystem::remove(file.path(), ec);
+
+        total -= entries[stem].second;
+    }
+}
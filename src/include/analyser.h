@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <climits>
+
+#include "utils.h"
+#include "waveform.h"
+#include "metrics.h"
+
+// Turns a stream of PCM samples into notes: every CHUNK_SIZE samples, the peak-to-peak amplitude of the chunk becomes
+// a note of `rate / amplitude` Hz lasting as long as the chunk, and silent chunks become rests. Samples can be pushed as
+// they are decoded, and are also added to the waveform of the current Waveform::Capture, if any.
+class Analyser
+{
+public:
+    Analyser(std::vector<std::pair<int, int>> &data, long rate) : data(data), rate(rate), waveform(Waveform::current())
+    {
+        if (waveform) waveform->begin(rate);
+    }
+
+    void push(int sample)
+    {
+        min = std::min(min, sample);
+        max = std::max(max, sample);
+        if (waveform) waveform->push(sample);
+
+        if (++count == CHUNK_SIZE) emit();
+    }
+
+    void finish()
+    {
+        if (count) emit();
+        if (waveform) waveform->finish();
+    }
+
+    [[nodiscard]] size_t samples() const { return total + count; }
+
+private:
+    void emit()
+    {
+        Metrics::StageTimer timer(Metrics::EMIT);
+        auto amplitude = max - min;
+
+        // Notes end where their last sample falls, rounded to the ms, so the rounding never accumulates and the notes
+        // stay in step with the audio (and its waveform) however long it runs.
+        total += count;
+        auto end = static_cast<long long>(static_cast<double>(total) * 1000.0 / static_cast<double>(rate) + 0.5);
+        auto duration = static_cast<int>(end - elapsed);
+        elapsed = end;
+
+        if (amplitude > THRESHOLD) data.emplace_back(static_cast<int>(rate / amplitude), duration);
+        else if (resting) data.back().second += duration;
+        else if (duration > 0) data.emplace_back(0, duration);
+        resting = amplitude <= THRESHOLD && !data.empty() && data.back().first == 0;
+
+        count = 0;
+        min = INT_MAX;
+        max = INT_MIN;
+    }
+
+    std::vector<std::pair<int, int>> &data;
+    long rate;
+    Waveform* waveform;
+    size_t count = 0, total = 0;
+    // Milliseconds covered by the notes emitted so far, and whether the last of them is a rest this analyser started.
+    long long elapsed = 0;
+    bool resting = false;
+    int min = INT_MAX, max = INT_MIN;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Compressed note archive. Notes are split into blocks of BLOCK_SIZE; each block stores delta-coded frequencies and
+// run-length coded durations as LEB128 varints, optionally passed through an order-0 rANS entropy coder. A block
+// index at the end of the file records each block's offset and start time for random access.
+struct ArchiveHeader
+{
+    static constexpr char MAGIC[4] = {'S', 'T', 'N', 'Z'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BLOCK_SIZE = 4096;
+
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint32_t blockSize, blockCount;
+    uint64_t indexOffset;
+};
+
+struct ArchiveBlock
+{
+    uint64_t offset;
+    int64_t start;
+};
+
+class ArchiveWriter
+{
+public:
+    static bool write(const std::vector<std::pair<int, int>> &data, const char* path, bool entropy = true);
+
+private:
+    // Writes the archive to `path` in place.
+    static bool writeFile(const std::vector<std::pair<int, int>> &data, const std::string &path, bool entropy);
+};
+
+// Decodes an archive one block at a time, so memory use does not depend on the archive length.
+class ArchiveReader
+{
+public:
+    bool open(const char* path);
+
+    [[nodiscard]] size_t size() const { return header.count; }
+    [[nodiscard]] size_t position() const { return blockStart + cursor; }
+
+    bool seek(size_t note);
+    bool seekTime(int64_t ms);
+    bool next(std::pair<int, int> &note);
+
+private:
+    bool loadBlock(size_t block);
+
+    std::ifstream file;
+    ArchiveHeader header = {};
+    std::vector<ArchiveBlock> index;
+    std::vector<std::pair<int, int>> notes;
+    size_t currentBlock = SIZE_MAX, blockStart = 0, cursor = 0;
+};
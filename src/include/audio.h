@@ -7,21 +7,38 @@
 #include <chrono>
 #include <cmath>
 #include <algorithm>
-
-#include <mpg123.h>
-#include <curl/curl.h>
+#include <numeric>
+#include <filesystem>
+#include <mutex>
+#include <set>
 
 #include "utils.h"
+#include "notes.h"
+#include "archive.h"
+#include "cache.h"
+#include "analyser.h"
+#include "plugins.h"
+#include "decoder.h"
+#include "pool.h"
+#include "metrics.h"
 
 class AudioManager
 {
 public:
-    static void importWAV(std::vector<std::pair<int, int>> &data, const char* path);
-    static void importMIDI(std::vector<std::pair<int, int>> &data, const char* path);
-    static void importMP3(std::vector<std::pair<int, int>> &data, const char* path);
-    static void importCSV(std::vector<std::pair<int, int>> &data, const char* path);
-    static void importSoundCloud(std::vector<std::pair<int, int>> &data, const char* id);
-    static void exportCSV(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importFile(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importWAV(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importMIDI(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importMP3(std::vector<std::pair<int, int>> &data, const char* path);
+    // Decodes `path` with the decoder plugin registered as `name`, such as the one PluginRegistry::identify() names.
+    static bool importPlugin(std::vector<std::pair<int, int>> &data, const char* path, const std::string &name);
+    static bool importCSV(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importBinary(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importArchive(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool importSoundCloud(std::vector<std::pair<int, int>> &data, const char* id);
+    static bool importSoundCloudPlaylist(std::vector<std::pair<int, int>> &data, const char* ids);
+    static bool exportCSV(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool exportBinary(std::vector<std::pair<int, int>> &data, const char* path);
+    static bool exportArchive(std::vector<std::pair<int, int>> &data, const char* path);
 
     static bool skipHeader;
 };
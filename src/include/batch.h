@@ -0,0 +1,44 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <glob.h>
+
+#include "audio.h"
+#include "pool.h"
+
+class BatchConverter
+{
+public:
+    enum class Format { CSV, Binary, Archive };
+
+    struct Options
+    {
+        std::string input, outputDir = ".";
+        Format format = Format::CSV;
+        unsigned int jobs = std::thread::hardware_concurrency();
+    };
+
+    struct Result
+    {
+        std::string input, output;
+        bool ok = false;
+        size_t bytes = 0, notes = 0;
+        double seconds = 0;
+    };
+
+    static std::vector<std::pair<std::string, std::string>> collect(const Options &options);
+    static bool run(const Options &options, std::ostream &report);
+    static bool parseFormat(const std::string &name, Format &format);
+    static const char* extension(Format format);
+
+    // Parses `--batch` style arguments, runs the conversion and returns the process exit code.
+    static int runCommandLine(int argc, char** argv);
+
+private:
+    static void convert(const Options &options, Result &result);
+    static void writeReport(std::ostream &report, const std::vector<Result> &results, double seconds,
+                            unsigned int jobs);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// On-disk cache of import results, keyed by a hash of the source file contents and the analyser parameters.
+// Entries are stored in the binary note format and evicted least-recently-used once the cache exceeds `limit` bytes.
+class ImportCache
+{
+public:
+    ImportCache(const char* path, const char* importer);
+
+    bool load(std::vector<std::pair<int, int>> &data) const;
+    void store(const std::vector<std::pair<int, int>> &data, size_t offset) const;
+
+    static std::filesystem::path root();
+    static std::filesystem::path directory();
+    static void evict(const std::filesystem::path &directory, uintmax_t limit, const char* extension);
+
+    static bool enabled;
+    static uintmax_t limit;
+
+private:
+
+    std::filesystem::path entry;
+};
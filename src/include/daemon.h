@@ -0,0 +1,166 @@
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <sys/types.h>
+
+#include "player.h"
+
+// Wire format of the playback daemon's Unix stream socket. Each request is a DaemonRequest followed, for ENQUEUE and
+// ALERT, by `count` notes as (int32 frequency, int32 duration in ms) pairs; the daemon answers every request with one
+// DaemonStatus. All values are little-endian. A malformed request is answered with REJECTED and the connection closed.
+struct DaemonRequest
+{
+    static constexpr char MAGIC[4] = {'S', 'T', 'D', 'Q'};
+    static constexpr uint32_t MAX_NOTES = 1 << 20;
+
+    enum Command : uint8_t
+    {
+        // Queues a sequence behind the earlier ones on the same queue.
+        ENQUEUE,
+        // Interrupts whatever is playing; the interrupted sequence resumes from the same note afterwards.
+        ALERT,
+        // Drops the queue's sequences and alerts, and stops the one playing if it came from the queue.
+        STOP,
+        STATUS
+    };
+
+    char magic[4];
+    uint8_t command;
+    // ENQUEUE only: higher priorities play first, and clients take turns within a priority.
+    uint8_t priority;
+    // Together with the sender's user ID, selects the queue a request works on, so separate connections (say, each
+    // run of a script) can add to and stop the same queue.
+    uint16_t channel;
+    uint32_t count;
+};
+
+static_assert(sizeof(DaemonRequest) == 12);
+
+struct DaemonStatus
+{
+    enum Result : uint8_t
+    {
+        OK, REJECTED
+    };
+
+    enum State : uint8_t
+    {
+        IDLE, PLAYING, ALERTING
+    };
+
+    char magic[4];
+    uint8_t result, state;
+    uint16_t clients;
+    // Sequences waiting to play, alerts included, across all clients.
+    uint32_t queued;
+    // Note index within the sequence playing, and the frequency sounding.
+    uint32_t note;
+    int32_t frequency;
+};
+
+static_assert(sizeof(DaemonStatus) == 20);
+
+// Headless playback server: owns the output device and plays sequences that local clients send over a Unix socket.
+// Each user and channel has its own queue and the queues take turns, so a client with a long backlog cannot hold back
+// another client's sequences, while alerts bypass the queues entirely and preempt playback as soon as they are read.
+// Queued sequences outlive the connection that sent them, so fire-and-forget senders work. Everything runs on one
+// epoll loop; the player thread only signals it through an eventfd when a note changes or playback ends.
+class Daemon
+{
+public:
+    using SinkFactory = std::function<std::unique_ptr<Player::Sink>()>;
+
+    // Limits on connected clients and on sequences waiting in one queue.
+    static constexpr size_t MAX_CLIENTS = 64, MAX_QUEUED = 1024;
+    // Bytes of sequences one user may have queued, alerting, interrupted or playing across all of their channels, and
+    // all users together. Requests beyond either are answered with REJECTED.
+    static constexpr size_t USER_BUDGET = 64 << 20, TOTAL_BUDGET = 256 << 20;
+
+    explicit Daemon(SinkFactory makeSink);
+    Daemon(const Daemon &) = delete;
+    Daemon &operator=(const Daemon &) = delete;
+    ~Daemon();
+
+    // Listens on `socketPath` and serves until one of `signals` arrives; they must be blocked in every thread.
+    // Returns false if the socket cannot be set up.
+    bool run(const std::string &socketPath, const sigset_t &signals);
+
+    // Real-time settings for the playback thread; see Player::RealTime.
+    Player::RealTime &realTime() { return player.realTime; }
+
+    // Client side: sends one request (with `notes` for ENQUEUE and ALERT) and waits for the daemon's status.
+    static bool request(const std::string &socketPath, DaemonRequest::Command command, uint8_t priority,
+                        uint16_t channel, const std::vector<std::pair<int, int>> &notes, DaemonStatus &status);
+
+private:
+    // A job's bytes held against its user's and the daemon's budgets, given back when the job is destroyed.
+    class Charge
+    {
+    public:
+        Charge() = default;
+        Charge(Daemon* daemon, uid_t uid, size_t bytes);
+        Charge(Charge &&other) noexcept;
+        Charge &operator=(Charge &&other) noexcept;
+        ~Charge();
+
+    private:
+        Daemon* daemon = nullptr;
+        uid_t uid = 0;
+        size_t bytes = 0;
+    };
+
+    struct Job
+    {
+        NoteSequence notes;
+        uint64_t owner;
+        uint8_t priority = 0;
+        size_t start = 0;
+        Charge charge;
+    };
+
+    struct Queue
+    {
+        // The sender's user ID and channel.
+        uint64_t owner;
+        std::deque<Job> jobs;
+    };
+
+    struct Connection
+    {
+        int fd;
+        uid_t uid;
+        std::vector<uint8_t> input;
+    };
+
+    bool accept();
+    // Handles every complete request in the connection's buffer; returns false to drop it.
+    bool receive(Connection &connection);
+    bool handle(Connection &connection, const DaemonRequest &header, const uint8_t* payload);
+    void reply(Connection &connection, DaemonStatus::Result result);
+    void stopOwnedBy(uint64_t owner);
+    // Starts the next sequence if nothing is playing: alerts first, then an interrupted sequence, then the queues.
+    void schedule();
+    void play(Job &&job, bool alert);
+
+    SinkFactory makeSink;
+    Player player;
+    int listenFd = -1, pollFd = -1, notifyFd;
+
+    std::vector<Connection> connections;
+    // Declared before the jobs, so the jobs' charges are given back while these still exist.
+    std::map<uid_t, size_t> userBytes;
+    size_t totalBytes = 0;
+    // In turn order: the queue served last moves to the back.
+    std::deque<Queue> queues;
+    std::deque<Job> alerts;
+    std::unique_ptr<Job> playing, interrupted;
+    bool alerting = false;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <utility>
+
+#include "plugin.h"
+#include "analyser.h"
+
+// Drives a decoder plugin: encoded bytes can be fed in arbitrary pieces (for example straight from a network transfer)
+// and the PCM it produces goes directly into an Analyser.
+class DecoderStream
+{
+public:
+    DecoderStream(const SoundTestPlugin* plugin, std::vector<std::pair<int, int>> &data);
+    DecoderStream(const DecoderStream &) = delete;
+    DecoderStream &operator=(const DecoderStream &) = delete;
+    ~DecoderStream();
+
+    bool feed(const unsigned char* bytes, size_t size);
+    bool finish();
+
+    [[nodiscard]] bool failed() const { return !decoder; }
+    [[nodiscard]] size_t samples() const { return analyser ? analyser->samples() : 0; }
+
+private:
+    static void format(void* context, long rate);
+    static int write(void* context, const void* pcm, size_t size);
+
+    const SoundTestPlugin* plugin;
+    std::vector<std::pair<int, int>> &data;
+    void* decoder = nullptr;
+    std::unique_ptr<Analyser> analyser;
+};
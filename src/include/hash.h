@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Streaming XXH64, used to key on-disk caches by file contents.
+class Hash64
+{
+public:
+    explicit Hash64(uint64_t seed = 0) : seed(seed)
+    {
+        lanes[0] = seed + PRIME1 + PRIME2;
+        lanes[1] = seed + PRIME2;
+        lanes[2] = seed;
+        lanes[3] = seed - PRIME1;
+    }
+
+    Hash64 &update(const void* input, size_t length)
+    {
+        auto bytes = static_cast<const uint8_t*>(input);
+        total += length;
+
+        if (buffered + length < sizeof(buffer))
+        {
+            std::memcpy(buffer + buffered, bytes, length);
+            buffered += length;
+            return *this;
+        }
+
+        if (buffered)
+        {
+            auto fill = sizeof(buffer) - buffered;
+            std::memcpy(buffer + buffered, bytes, fill);
+            consume(buffer);
+
+            bytes += fill;
+            length -= fill;
+            buffered = 0;
+        }
+
+        for (; length >= sizeof(buffer); bytes += sizeof(buffer), length -= sizeof(buffer)) consume(bytes);
+
+        std::memcpy(buffer, bytes, length);
+        buffered = length;
+        return *this;
+    }
+
+    Hash64 &update(const std::string &text) { return update(text.data(), text.size()); }
+
+    [[nodiscard]] uint64_t digest() const
+    {
+        uint64_t hash = total >= sizeof(buffer)
+                        ? rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18)
+                        : seed + PRIME5;
+
+        if (total >= sizeof(buffer))
+            for (auto lane: lanes) hash = (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+
+        hash += total;
+
+        size_t i = 0;
+        for (; i + 8 <= buffered; i += 8) hash = rotl(hash ^ round(0, read64(buffer + i)), 27) * PRIME1 + PRIME4;
+        for (; i + 4 <= buffered; i += 4) hash = rotl(hash ^ read32(buffer + i) * PRIME1, 23) * PRIME2 + PRIME3;
+        for (; i < buffered; ++i) hash = rotl(hash ^ buffer[i] * PRIME5, 11) * PRIME1;
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        return hash ^ hash >> 32;
+    }
+
+    static uint64_t of(const void* input, size_t length, uint64_t seed = 0)
+    {
+        return Hash64(seed).update(input, length).digest();
+    }
+
+private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL, PRIME2 = 0xC2B2AE3D27D4EB4FULL,
+        PRIME3 = 0x165667B19E3779F9ULL, PRIME4 = 0x85EBCA77C2B2AE63ULL, PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t value, int bits) { return value << bits | value >> (64 - bits); }
+    static uint64_t round(uint64_t lane, uint64_t input) { return rotl(lane + input * PRIME2, 31) * PRIME1; }
+
+    static uint64_t read64(const uint8_t* bytes)
+    {
+        uint64_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    static uint64_t read32(const uint8_t* bytes)
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    void consume(const uint8_t* stripe)
+    {
+        for (int i = 0; i < 4; ++i) lanes[i] = round(lanes[i], read64(stripe + i * 8));
+    }
+
+    uint64_t seed, lanes[4] = {}, total = 0;
+    uint8_t buffer[32] = {};
+    size_t buffered = 0;
+};
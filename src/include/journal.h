@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "sequence.h"
+
+// Undo/redo journal for a note sequence. Every edit is applied through the journal and recorded as a small delta: a
+// single-note change keeps the old and new note, a swap or rotation only its indices. Edits that remove notes keep
+// the removed notes on a stack beside the entries, and notes added by imports are only moved onto the redo stack
+// once they are undone, so undo and redo each cost O(size of the edit) and the journal never holds a snapshot.
+class Journal
+{
+public:
+    explicit Journal(NoteSequence &data) : data(data) {}
+
+    // Replaces one note. Consecutive changes to the same note merge into one entry until `seal` is called, so a
+    // slider drag undoes in one step.
+    void set(size_t index, std::pair<int, int> note);
+    // Swaps the notes at `index` and `index + 1`.
+    void swap(size_t index);
+    // std::rotate over [first, last) so that `middle` becomes the first note.
+    void rotate(size_t first, size_t middle, size_t last);
+    void erase(size_t first, size_t last);
+    // Records notes that were already inserted at [first, data.size()), for example by an importer.
+    void appended(size_t first);
+
+    // Makes the next edit undo together with the previous one.
+    void link() { linkNext = true; }
+    void seal() { open = false; }
+
+    bool undo();
+    bool redo();
+    void clear();
+
+    [[nodiscard]] bool canUndo() const { return !undoEntries.empty(); }
+    [[nodiscard]] bool canRedo() const { return !redoEntries.empty(); }
+    [[nodiscard]] size_t bytes() const;
+
+    // Oldest entries beyond this are forgotten.
+    static constexpr size_t limit = 1 << 16;
+
+private:
+    enum Kind : uint8_t
+    {
+        SET, SWAP, ROTATE, ERASE, INSERT
+    };
+
+    // Ranges are stored as (first, count); ROTATE keeps the rotation in `shift`.
+    struct Entry
+    {
+        Kind kind;
+        bool linked;
+        uint32_t first, count, shift;
+        std::pair<int, int> before, after;
+    };
+
+    using Notes = std::deque<std::pair<int, int>>;
+
+    void record(Entry entry);
+    void apply(const Entry &entry, bool forward, Notes &from, Notes &to);
+
+    NoteSequence &data;
+    std::deque<Entry> undoEntries, redoEntries;
+    Notes undoNotes, redoNotes;
+    bool open = false, linkNext = false;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "trace.h"
+
+// Process-wide registry of named gauges and histograms that any subsystem can publish into. Metrics are looked up once
+// by name (a string literal, as names are not copied) and then updated with relaxed atomics, so publishing never
+// blocks and is cheap enough for the audio and import paths.
+class Metrics
+{
+public:
+    class Gauge
+    {
+    public:
+        void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+        void add(int64_t value) { current.fetch_add(value, std::memory_order_relaxed); }
+        [[nodiscard]] int64_t value() const { return current.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> current = 0;
+    };
+
+    // Log-linear histogram with four buckets per power of two (at most 25% error), plus a ring of the latest values.
+    class Histogram
+    {
+    public:
+        static constexpr size_t BUCKETS = 256, RECENT = 128;
+
+        void record(uint64_t value);
+        void reset();
+
+        [[nodiscard]] uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t max() const { return largest.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t percentile(double fraction) const;
+        void recent(float (&values)[RECENT]) const;
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::array<std::atomic<float>, RECENT> latest{};
+        std::atomic<uint64_t> total = 0, largest = 0, position = 0;
+    };
+
+    static Gauge &gauge(const char* name);
+    static Histogram &histogram(const char* name);
+
+    // Visits every registered metric in registration order; `visitor(name, gauge, histogram)` gets one of the two.
+    template<typename Visitor>
+    static void forEach(Visitor visitor)
+    {
+        for (auto &slot: slots)
+        {
+            if (slot.state.load(std::memory_order_acquire) != READY) break;
+            if (slot.kind == GAUGE) visitor(slot.name, &slot.gauge, nullptr);
+            else visitor(slot.name, nullptr, &slot.histogram);
+        }
+    }
+
+    // Import timing: an ImportScope resets the per-thread stage clocks and publishes them as `import.*_us` gauges when
+    // it ends. StageTimers nest, and time is only charged to the innermost stage.
+    enum Stage
+    {
+        READ, DECODE, ANALYSE, EMIT, STAGES
+    };
+
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(Stage stage);
+        StageTimer(const StageTimer &) = delete;
+        StageTimer &operator=(const StageTimer &) = delete;
+        ~StageTimer();
+
+    private:
+        int previous;
+#ifdef SOUNDTEST_TRACING
+        Trace::Span span;
+#endif
+    };
+
+    class ImportScope
+    {
+    public:
+        explicit ImportScope(const char* importer);
+        ImportScope(const ImportScope &) = delete;
+        ImportScope &operator=(const ImportScope &) = delete;
+        ~ImportScope();
+
+    private:
+        const char* importer;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    static const char* lastImport() { return lastImporter.load(std::memory_order_relaxed); }
+
+private:
+    enum Kind
+    {
+        GAUGE, HISTOGRAM
+    };
+
+    enum State
+    {
+        EMPTY, CLAIMED, READY
+    };
+
+    struct Slot
+    {
+        std::atomic<int> state = EMPTY;
+        const char* name = nullptr;
+        Kind kind = GAUGE;
+        Gauge gauge;
+        Histogram histogram;
+    };
+
+    static Slot &find(const char* name, Kind kind);
+
+    static std::array<Slot, 64> slots;
+    static std::atomic<const char*> lastImporter;
+};
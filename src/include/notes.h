@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Native binary note format: a fixed 64-byte header followed by 64-byte aligned columns of frequency (int32),
+// duration (int32, ms) and precomputed start time (int64, ms). All values are little-endian.
+struct NoteFileHeader
+{
+    static constexpr char MAGIC[4] = {'S', 'T', 'N', 'B'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t ALIGNMENT = 64;
+
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t frequencyOffset, durationOffset, startOffset;
+    uint64_t totalDuration;
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(NoteFileHeader) == NoteFileHeader::ALIGNMENT);
+
+// Read-only, zero-copy view of a note file mapped with mmap. Pages are shared through the page cache.
+class NoteView
+{
+public:
+    class Iterator
+    {
+    public:
+        Iterator(const NoteView* view, size_t index) : view(view), index(index) {}
+
+        std::pair<int, int> operator*() const { return (*view)[index]; }
+        Iterator &operator++()
+        {
+            ++index;
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const { return index != other.index; }
+
+    private:
+        const NoteView* view;
+        size_t index;
+    };
+
+    NoteView() = default;
+    NoteView(const NoteView &) = delete;
+    NoteView(NoteView &&other) noexcept;
+    NoteView &operator=(const NoteView &) = delete;
+    NoteView &operator=(NoteView &&other) noexcept;
+    ~NoteView();
+
+    bool open(const char* path);
+    void close();
+
+    [[nodiscard]] size_t size() const { return header ? header->count : 0; }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] int64_t totalDuration() const { return header ? static_cast<int64_t>(header->totalDuration) : 0; }
+
+    [[nodiscard]] const int32_t* frequencies() const { return frequency; }
+    [[nodiscard]] const int32_t* durations() const { return duration; }
+    [[nodiscard]] const int64_t* starts() const { return start; }
+
+    std::pair<int, int> operator[](size_t i) const { return {frequency[i], duration[i]}; }
+    [[nodiscard]] Iterator begin() const { return {this, 0}; }
+    [[nodiscard]] Iterator end() const { return {this, size()}; }
+
+    static bool write(const std::vector<std::pair<int, int>> &data, const char* path);
+
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    const NoteFileHeader* header = nullptr;
+    const int32_t* frequency = nullptr;
+    const int32_t* duration = nullptr;
+    const int64_t* start = nullptr;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// Floating window showing frame cost, draw list size, the last import's stage timings, playback jitter and memory use,
+// all read from the Metrics registry. Toggled with F3 or from the settings.
+class PerformanceOverlay
+{
+public:
+    static void draw();
+
+    static bool visible;
+};
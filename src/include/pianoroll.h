@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include <imgui/imgui.h>
+
+#include "sequence.h"
+
+// Zoomable, pannable piano-roll view of a note sequence. Visible notes are found by searching a Fenwick tree of
+// durations; when more notes fall in view than there are pixel columns, each column is drawn as a single min/max pitch
+// bar queried from a segment tree, so frame cost depends on the panel width rather than the note count.
+class PianoRoll
+{
+public:
+    // `revision` must change whenever `data` is edited. Returns true when the user clicked to seek; `cursor` is then
+    // the index of the note under the mouse.
+    bool draw(const NoteSequence &data, unsigned int revision, size_t &cursor, size_t playing);
+    // Applies an edit that replaced the note at `index` and moved the data to `revision`, in O(log n). Any other edit
+    // makes the next draw() rebuild from scratch.
+    void set(size_t index, std::pair<int, int> note, unsigned int revision);
+
+    [[nodiscard]] double viewStart() const { return scroll; }
+    [[nodiscard]] double viewScale() const { return msPerPixel; }
+
+private:
+    void rebuild(const NoteSequence &data);
+    [[nodiscard]] std::pair<int, int> pitchRange(size_t first, size_t last) const;
+    [[nodiscard]] size_t noteAt(double time) const;
+    // Start time of note `index`, in ms; start(leaves) is the total duration.
+    [[nodiscard]] int64_t start(size_t index) const;
+
+    // Fenwick tree over the note durations, 1-based.
+    std::vector<int64_t> durations;
+    std::vector<std::pair<int, int>> tree;
+    size_t leaves = 0;
+    unsigned int builtRevision = 0;
+    bool built = false;
+
+    double scroll = 0, msPerPixel = 10;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <csignal>
+#include <algorithm>
+
+#include "snapshot.h"
+#include "playlist.h"
+#include "ring.h"
+#include "notes.h"
+#include "archive.h"
+
+// Plays notes on the console speaker (or any other Sink) from a background thread, so the GUI stays responsive during playback. The
+// notify callback is invoked from the playback thread whenever the current note changes or playback ends.
+//
+// The playback thread runs a single epoll loop over a timerfd armed at the next note's absolute deadline, an eventfd
+// for commands and, optionally, a signalfd. It wakes once per note boundary and reacts to commands immediately, even
+// in the middle of a note.
+class Player
+{
+public:
+    // Where the notes go. Calls come from the playback thread.
+    class Sink
+    {
+    public:
+        virtual ~Sink() = default;
+        virtual bool tone(int frequency) = 0;
+        virtual void silence() = 0;
+    };
+
+    // The PC speaker, driven through KIOCSOUND on a console device.
+    class ConsoleSink : public Sink
+    {
+    public:
+        explicit ConsoleSink(const std::string &device);
+        ~ConsoleSink() override;
+
+        [[nodiscard]] bool ready() const { return fd >= 0; }
+        bool tone(int frequency) override;
+        void silence() override;
+
+    private:
+        int fd;
+    };
+
+    // Opt-in real-time mode for the playback thread: SCHED_FIFO, memory locked while it plays with a pre-faulted stack,
+    // pinned to an isolated CPU and minimal timer slack. Each step that lacks permission is reported and skipped. Meant
+    // for the CLI and the daemon, which own their process; it only helps when other work competes for the CPU.
+    struct RealTime
+    {
+        bool enabled = false;
+        int priority = 50;
+        // -1 picks the first CPU in /sys/devices/system/cpu/isolated and leaves affinity alone if there is none.
+        int cpu = -1;
+    };
+
+    explicit Player(std::function<void()> notify = {});
+    Player(const Player &) = delete;
+    Player &operator=(const Player &) = delete;
+    ~Player();
+
+    // Plays whatever version `notes` holds when each note starts, so edits published while playing are heard without
+    // the player ever waiting for the editor. `notes` must outlive playback.
+    bool play(const SnapshotStore &notes, size_t start, const std::string &device);
+    void play(const SnapshotStore &notes, size_t start, std::unique_ptr<Sink> sink);
+    // Plays a fixed sequence.
+    bool play(const NoteSequence &notes, size_t start, const std::string &device);
+    void play(const NoteSequence &notes, size_t start, std::unique_ptr<Sink> sink);
+    // Plays a note file straight from its mapping, so nothing is copied and only the pages played are read. `notes`
+    // must outlive playback.
+    bool play(const NoteView &notes, size_t start, const std::string &device);
+    void play(const NoteView &notes, size_t start, std::unique_ptr<Sink> sink);
+    // Plays an archive while decoding it, one block at a time as playback reaches it, so memory use does not depend
+    // on its length. `notes` must outlive playback and is not to be used elsewhere meanwhile.
+    bool play(ArchiveReader &notes, size_t start, const std::string &device);
+    void play(ArchiveReader &notes, size_t start, std::unique_ptr<Sink> sink);
+    // Plays the items of `playlist` back to back, each from the deadline the previous one ends on. `playlist` must
+    // outlive playback; seek() moves within the item playing.
+    bool play(Playlist &playlist, const std::string &device);
+    void play(Playlist &playlist, std::unique_ptr<Sink> sink);
+    // Plays events from `ring` as another process pushes them, until it calls finish(). The player sleeps on the ring
+    // while it is empty and starts the next event as soon as one arrives; running dry mid-stream counts an underrun.
+    // `ring` must outlive playback, and seek() has no effect.
+    bool play(NoteRing &ring, const std::string &device);
+    void play(NoteRing &ring, std::unique_ptr<Sink> sink);
+    void stop();
+    void pause();
+    void resume();
+    // Continues from note `index`, immediately.
+    void seek(size_t index);
+
+    // Playback stops when one of `signals` arrives. They must be blocked in every thread (before any are started) so
+    // they are only delivered through the signalfd. Read when playback starts.
+    void stopOnSignals(const sigset_t &signals) { stopSignals = signals; }
+
+    // Playback speed (MIN_TEMPO to MAX_TEMPO) and pitch shift in semitones, applied to each note as it starts rather
+    // than to the stored notes. Changes take effect from the next note, including while playing.
+    void setTempo(float factor) { tempoFactor = std::clamp(factor, MIN_TEMPO, MAX_TEMPO); }
+    void setTranspose(int semitones) { shift = std::clamp(semitones, -MAX_TRANSPOSE, MAX_TRANSPOSE); }
+    [[nodiscard]] float tempo() const { return tempoFactor; }
+    [[nodiscard]] int transpose() const { return shift; }
+
+    static constexpr float MIN_TEMPO = 0.25f, MAX_TEMPO = 4.0f;
+    static constexpr int MAX_TRANSPOSE = 24;
+
+    // Read when playback starts.
+    RealTime realTime;
+
+    [[nodiscard]] bool playing() const { return active; }
+    [[nodiscard]] bool paused() const { return isPaused; }
+    [[nodiscard]] size_t note() const { return current; }
+    [[nodiscard]] int frequency() const { return currentFreq; }
+
+private:
+    // Where run() takes its notes from; exactly one is set.
+    struct Source
+    {
+        const SnapshotStore* notes = nullptr;
+        Playlist* playlist = nullptr;
+        NoteRing* ring = nullptr;
+        const NoteView* view = nullptr;
+        ArchiveReader* archive = nullptr;
+    };
+
+    void run(Source source, size_t start, std::unique_ptr<Sink> sink, RealTime mode);
+    const SnapshotStore &fixed(const NoteSequence &notes);
+
+    enum class Command : uint8_t
+    {
+        STOP, PAUSE, RESUME, SEEK
+    };
+
+    void send(Command command, size_t index = 0);
+
+    std::function<void()> notify;
+    std::unique_ptr<SnapshotStore> owned;
+    std::thread thread;
+    sigset_t stopSignals{};
+
+    // Commands are queued under the mutex and signalled through the eventfd.
+    int commandFd;
+    std::mutex mutex;
+    std::vector<std::pair<Command, size_t>> commands;
+    // Lets commands reach a player asleep on a ring rather than in epoll.
+    std::atomic<bool> commandPending = false;
+    NoteRing* ring = nullptr;
+
+    std::atomic<bool> active = false, isPaused = false;
+    std::atomic<float> tempoFactor = 1.0f;
+    std::atomic<int> shift = 0;
+    std::atomic<size_t> current = SIZE_MAX;
+    std::atomic<int> currentFreq = 0;
+};
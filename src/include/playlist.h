@@ -0,0 +1,66 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "sequence.h"
+
+// Queue of files for the player to play back to back. A background thread imports the items ahead of the one playing,
+// in order, and keeps them as ready-to-play sequences while their total size stays within `budget` bytes (the item
+// right after the one playing is always loaded, however large). The player takes the next item at the deadline the
+// previous one ends on, so there is no gap as long as loading stays ahead of playback; readyFd() becomes readable
+// whenever an item finishes loading, for a player that got there first. Items that fail to import are skipped.
+class Playlist
+{
+public:
+    enum class Next
+    {
+        READY, PENDING, END
+    };
+
+    static constexpr size_t DEFAULT_BUDGET = 64 << 20;
+
+    explicit Playlist(size_t budget = DEFAULT_BUDGET);
+    Playlist(const Playlist &) = delete;
+    Playlist &operator=(const Playlist &) = delete;
+    ~Playlist();
+
+    void add(const std::string &path);
+
+    // Player side: replaces `program` with the next item if it has been loaded. The replaced item is handed back to
+    // the loader thread to free, so the caller never deallocates.
+    Next take(std::shared_ptr<const NoteSequence> &program);
+    [[nodiscard]] int readyFd() const { return eventFd; }
+
+    [[nodiscard]] size_t size() const;
+    // Index of the item taken last, or SIZE_MAX before the first.
+    [[nodiscard]] size_t position() const;
+    // Bytes held by loaded items that have not been taken yet.
+    [[nodiscard]] size_t buffered() const;
+
+private:
+    void load();
+
+    struct Item
+    {
+        std::string path;
+        std::shared_ptr<const NoteSequence> notes;
+        size_t bytes = 0;
+        bool loaded = false, failed = false;
+    };
+
+    std::deque<Item> items;
+    // Next item to take, next item to load and the first taken item whose notes have not been freed yet.
+    size_t next = 0, loading = 0, released = 0;
+    size_t budget, bufferedBytes = 0;
+    int eventFd;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+    std::thread loader;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// C ABI between SoundTest and its dlopen-loaded plugins. A plugin exports `soundtest_plugin`, which gets the host's
+// callbacks and returns a descriptor with the same ABI version. Decoders implement open/feed/finish/close, sources
+// implement fetch; unused entries are null.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOUNDTEST_PLUGIN_ABI 1
+#define SOUNDTEST_PLUGIN_ENTRY "soundtest_plugin"
+
+typedef struct SoundTestHost
+{
+    uint32_t abi;
+    // Shows an error to the user. Plugins log to stderr themselves.
+    void (*error)(const char* message);
+    // Directory plugins may keep their own caches under.
+    const char* cacheDirectory;
+} SoundTestHost;
+
+// Receives a plugin's output. Decoders call `format` whenever the sample rate changes and pass native-endian 16-bit
+// samples to `write`; sources pass the fetched bytes to `write`. Returning 0 from `write` aborts.
+typedef struct SoundTestSink
+{
+    void* context;
+    void (*format)(void* context, long rate);
+    int (*write)(void* context, const void* data, size_t size);
+} SoundTestSink;
+
+typedef struct SoundTestPlugin
+{
+    uint32_t abi;
+    const char* name;
+
+    // Incremental decoding of an encoded stream fed in arbitrary pieces. Each call returns 0 on failure.
+    void* (*open)(const SoundTestSink* sink);
+    int (*feed)(void* decoder, const unsigned char* data, size_t size);
+    int (*finish)(void* decoder);
+    void (*close)(void* decoder);
+
+    // Fetches `count` items by id into one sink each and returns how many succeeded, setting `ok[i]` per item. A single
+    // item is streamed into its sink as it arrives; with several, each sink gets its whole item in one write.
+    size_t (*fetch)(const char* const* ids, size_t count, const SoundTestSink* sinks, int* ok);
+} SoundTestPlugin;
+
+typedef const SoundTestPlugin* (*SoundTestPluginEntry)(const SoundTestHost* host);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "plugin.h"
+
+// Importers that live in dlopen-loaded modules. Each one is registered with the magic bytes that identify its files,
+// so looking a file up never loads anything; the module is only opened the first time its importer is used. A module
+// that is missing or fails to load disables just that importer, and the reason is reported once.
+class PluginRegistry
+{
+public:
+    struct Magic
+    {
+        size_t offset;
+        std::vector<unsigned char> bytes, mask;
+    };
+
+    static constexpr size_t HEADER_SIZE = 16;
+
+    static void add(const std::string &name, const std::string &module, std::vector<Magic> magic = {});
+    static const SoundTestPlugin* get(const std::string &name);
+
+    // Name of the plugin whose magic matches the first bytes of a file, or an empty string.
+    static std::string identify(const unsigned char* header, size_t size);
+
+private:
+    struct Entry
+    {
+        std::string name, module;
+        std::vector<Magic> magic;
+        bool attempted = false;
+        const SoundTestPlugin* plugin = nullptr;
+    };
+
+    static std::vector<Entry> &entries();
+    static const SoundTestPlugin* load(const Entry &entry);
+
+    static std::mutex mutex;
+};
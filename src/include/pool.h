@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned int workers, size_t queueLimit = 0);
+    ~WorkerPool();
+
+    void submit(std::function<void()> task);
+    void wait();
+
+private:
+    void work();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady, taskTaken, idle;
+    size_t queueLimit, running = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+// Note data compiled in from lib/res/*.csv by cmake/presets.cmake.
+struct Preset
+{
+    const char* name;
+    const std::pair<int, int>* notes;
+    size_t size;
+};
+
+extern const Preset PRESETS[];
+extern const size_t PRESET_COUNT;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// One note as it travels through a NoteRing.
+struct NoteEvent
+{
+    int32_t frequency;
+    // Milliseconds.
+    int32_t duration;
+};
+
+// Layout of a NoteRing's shared memory object: this header, then `capacity` NoteEvents. Producer and consumer fields
+// sit on separate cache lines so neither side's writes bounce the other's.
+struct NoteRingHeader
+{
+    static constexpr char MAGIC[4] = {'S', 'T', 'N', 'R'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity, eventSize;
+
+    // Producer side: events written so far, events dropped because the ring was full, and set once it is done.
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint64_t> overruns;
+    std::atomic<uint32_t> closed;
+
+    // Consumer side: events read so far, times it ran dry mid-stream, and the futex word it sleeps on (1 while asleep
+    // or about to be).
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> underruns;
+    std::atomic<uint32_t> sleeping;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "ring counters must be address-free to be shared between processes");
+
+// Single-producer, single-consumer ring of NoteEvents in named POSIX shared memory (shm_open), for feeding the player
+// from another process. Pushing an event is a copy and a release store; the only system call is a futex wake, and
+// only when the consumer has gone to sleep on an empty ring. A full ring drops the event and counts an overrun.
+class NoteRing
+{
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 4096;
+
+    NoteRing() = default;
+    NoteRing(const NoteRing &) = delete;
+    NoteRing &operator=(const NoteRing &) = delete;
+    ~NoteRing();
+
+    // Opens the ring called `name` (for example "/soundtest"), creating it with `capacity` events, rounded up to a
+    // power of two, if it does not exist yet. Either side may create it.
+    bool open(const std::string &name, uint32_t capacity = DEFAULT_CAPACITY);
+    // Unmaps the ring; the shared memory object itself stays until unlink().
+    void close();
+    static bool unlink(const std::string &name);
+
+    // Producer side.
+    bool push(const NoteEvent &event);
+    // Pushes as many of `events` as fit and returns how many; the rest count as overruns.
+    size_t push(const NoteEvent* events, size_t count);
+    // Tells the consumer no more events are coming; it finishes once it has played what is queued.
+    void finish();
+
+    // Consumer side.
+    bool pop(NoteEvent &event);
+    // Sleeps until an event is pushed, the producer finishes, interrupt() is called or `timeout` (ms, -1 for none)
+    // passes. A `cancel` flag set before calling interrupt() is never missed, even when it races with falling asleep.
+    void wait(const std::atomic<bool>* cancel = nullptr, int timeout = -1);
+    // Wakes a consumer sleeping in wait(); safe from any thread or process.
+    void interrupt();
+    void underrun();
+    [[nodiscard]] bool finished() const;
+
+    [[nodiscard]] bool isOpen() const { return header != nullptr; }
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t capacity() const { return header ? header->capacity : 0; }
+    [[nodiscard]] uint64_t overruns() const { return header ? header->overruns.load(std::memory_order_relaxed) : 0; }
+    [[nodiscard]] uint64_t underruns() const { return header ? header->underruns.load(std::memory_order_relaxed) : 0; }
+
+private:
+    NoteRingHeader* header = nullptr;
+    NoteEvent* events = nullptr;
+    size_t mappedSize = 0;
+    uint64_t mask = 0;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+
+// Editable note sequence stored as a list of chunks of at most 2 * CHUNK notes, with the index of each chunk's first
+// note kept alongside. Finding a note is a binary search over the chunks, and an insert, erase or move only touches
+// the chunks at its ends, shifting chunk pointers rather than notes. Chunks are shared between copies and copied on
+// write, so copying a sequence (for example to hand it to the player) only copies pointers, and iterating it runs
+// through contiguous arrays.
+class NoteSequence
+{
+public:
+    using Note = std::pair<int, int>;
+    using Chunk = std::vector<Note>;
+
+    static constexpr size_t CHUNK = 1024;
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Note;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Note*;
+        using reference = const Note &;
+
+        Iterator() = default;
+        Iterator(const NoteSequence* sequence, size_t chunk, size_t offset)
+                : sequence(sequence), chunk(chunk), offset(offset) {}
+
+        reference operator*() const { return (*sequence->chunks[chunk])[offset]; }
+        pointer operator->() const { return &**this; }
+
+        Iterator &operator++()
+        {
+            if (++offset == sequence->chunks[chunk]->size())
+            {
+                ++chunk;
+                offset = 0;
+            }
+
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const Iterator &other) const { return chunk == other.chunk && offset == other.offset; }
+
+    private:
+        const NoteSequence* sequence = nullptr;
+        size_t chunk = 0, offset = 0;
+    };
+
+    NoteSequence() = default;
+    explicit NoteSequence(const std::vector<Note> &notes) { insert(0, notes.data(), notes.size()); }
+
+    [[nodiscard]] size_t size() const { return starts.empty() ? 0 : starts.back(); }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+    [[nodiscard]] Note operator[](size_t index) const;
+    [[nodiscard]] Iterator begin() const { return {this, 0, 0}; }
+    [[nodiscard]] Iterator end() const { return {this, chunks.size(), 0}; }
+    [[nodiscard]] Iterator at(size_t index) const;
+
+    void set(size_t index, Note note);
+    void insert(size_t index, const Note* notes, size_t count);
+    void append(const std::vector<Note> &notes) { insert(size(), notes.data(), notes.size()); }
+    void push_back(Note note) { insert(size(), &note, 1); }
+    void erase(size_t first, size_t last);
+    // std::rotate over [first, last) so that `middle` becomes the first note; only the shorter side is copied.
+    void rotate(size_t first, size_t middle, size_t last);
+    void clear();
+
+    [[nodiscard]] std::vector<Note> copy(size_t first, size_t last) const;
+    [[nodiscard]] std::vector<Note> toVector() const { return copy(0, size()); }
+    [[nodiscard]] size_t bytes() const;
+
+private:
+    // Chunk holding `index` and the offset within it; `index == size()` maps past the end of the last chunk.
+    [[nodiscard]] std::pair<size_t, size_t> locate(size_t index) const;
+    Chunk &writable(size_t chunk);
+    // Splits chunk `chunk` at `offset` so a chunk starts there, and returns that chunk's position.
+    size_t split(size_t chunk, size_t offset);
+    void merge(size_t chunk);
+    void reindex(size_t from);
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    // starts[i] is the index of chunk i's first note and starts[chunks.size()] the total size.
+    std::vector<size_t> starts;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "sequence.h"
+
+// Publishes immutable versions of a NoteSequence to readers on other threads. A single writer publishes a new version
+// by swapping an atomic pointer; copying the sequence only copies chunk pointers, and any chunk the writer edits
+// afterwards is copied on write, so a published version never changes. Readers pin the current version with a Guard,
+// which takes no locks and never waits for the writer. Replaced versions are freed by the writer with epoch-based
+// reclamation, once no reader can still be inside an epoch that saw them.
+class SnapshotStore
+{
+public:
+    struct Snapshot
+    {
+        NoteSequence notes;
+        uint64_t version;
+    };
+
+    // Read-side critical section. Keep it short: the version it pins, and everything published after it, stays
+    // allocated until it ends.
+    class Guard
+    {
+    public:
+        explicit Guard(const SnapshotStore &store);
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        ~Guard();
+
+        const Snapshot &operator*() const { return *snapshot; }
+        const Snapshot* operator->() const { return snapshot; }
+
+    private:
+        std::atomic<uint64_t>* slot;
+        const Snapshot* snapshot;
+    };
+
+    // Concurrent readers are limited to this many; more wait for a free slot.
+    static constexpr size_t READERS = 16;
+
+    SnapshotStore();
+    SnapshotStore(const SnapshotStore &) = delete;
+    SnapshotStore &operator=(const SnapshotStore &) = delete;
+    ~SnapshotStore();
+
+    // Writer thread only.
+    void publish(const NoteSequence &notes);
+    [[nodiscard]] uint64_t version() const { return current.load()->version; }
+    [[nodiscard]] size_t retired() const { return retiredVersions.size(); }
+
+private:
+    void reclaim();
+
+    struct alignas(64) Slot
+    {
+        // 0 while free, 1 while claimed but not yet pinned, otherwise the epoch the reader entered in.
+        mutable std::atomic<uint64_t> epoch = 0;
+    };
+
+    std::atomic<const Snapshot*> current;
+    std::atomic<uint64_t> epoch = 2;
+    Slot slots[READERS];
+    std::vector<std::pair<const Snapshot*, uint64_t>> retiredVersions;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Public API of soundtest_core: the note store format, importers and exporters, batch conversion and playback.
+// Notes are (frequency in Hz, duration in ms) pairs; errors are logged to stderr and passed to `errorHandler`.
+
+#include "utils.h"
+#include "audio.h"
+#include "batch.h"
+#include "notes.h"
+#include "sequence.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "playlist.h"
+#include "daemon.h"
+#include "ring.h"
+#include "archive.h"
+#include "player.h"
+#include "waveform.h"
+#include "metrics.h"
+#include "trace.h"
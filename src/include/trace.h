@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped spans and instant events recorded into per-thread ring buffers and exported as Chrome trace-event JSON
+// (load it in chrome://tracing or ui.perfetto.dev). Recording a span costs two timestamp reads and a store into the
+// thread's own buffer, which is allocated (about 400 KB) on the thread's first event. While tracing is not enabled
+// (SOUNDTEST_TRACE unset), a span is one relaxed load and no buffer is allocated; with SOUNDTEST_TRACING off, the
+// macros expand to nothing. Names must be string literals.
+class Trace
+{
+public:
+    struct Event
+    {
+        const char* name;
+        uint64_t start, duration;
+    };
+
+    // Marks instant events, which have no duration.
+    static constexpr uint64_t INSTANT = UINT64_MAX;
+
+    class Span
+    {
+    public:
+        explicit Span(const char* name) : name(name), start(enabled.load(std::memory_order_relaxed) ? now() : 0) {}
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+        ~Span()
+        {
+            if (start) record(name, start, now() - start);
+        }
+
+    private:
+        const char* name;
+        uint64_t start;
+    };
+
+    static void instant(const char* name)
+    {
+        if (enabled.load(std::memory_order_relaxed)) record(name, now(), INSTANT);
+    }
+
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    static void record(const char* name, uint64_t start, uint64_t duration);
+    static void nameThread(const char* name);
+    static bool write(const std::string &path);
+    // Writes to $SOUNDTEST_TRACE, if set; front-ends call this on exit.
+    static void flush();
+
+    static std::atomic<bool> enabled;
+};
+
+#ifdef SOUNDTEST_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_INSTANT(name) Trace::instant(name)
+#define TRACE_THREAD(name) Trace::nameThread(name)
+#else
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_INSTANT(name) ((void) 0)
+#define TRACE_THREAD(name) ((void) 0)
+#endif
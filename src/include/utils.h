@@ -1,33 +1,27 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <atomic>
 #include <bit>
 
-#include <imgui/imgui.h>
-
 constexpr int CLOCK_RATE = 1193182;
 constexpr int CHUNK_SIZE = 1000;
 constexpr double THRESHOLD = 0.1;
+// Bumped whenever the analyser's output changes for the same input, so cached imports are redone.
+constexpr int ANALYSER_VERSION = 2;
+constexpr unsigned int SOUNDCLOUD_CONCURRENCY = 8;
 
-[[maybe_unused]] static int WIDTH = 1366, HEIGHT = 768;
-static std::string errorMessage;
+// Errors are always logged to stderr and then passed to the handler, if one is installed, so a front-end can show them.
+// The handler may be called from any thread.
+using ErrorHandler = void (*)(const std::string &message);
+inline std::atomic<ErrorHandler> errorHandler = nullptr;
 
 static void error(const std::string &message)
 {
-    if (ImGui::GetCurrentContext())
-    {
-        errorMessage = message;
-        ImGui::OpenPopup("Error");
-
-        if (ImGui::BeginPopup("Error"))
-        {
-            ImGui::Text("%s", errorMessage.c_str());
-            if (ImGui::Button("OK")) ImGui::CloseCurrentPopup();
-            ImGui::EndPopup();
-        }
-    }
-
     std::cerr << message << std::endl;
+    if (auto handler = errorHandler.load()) handler(message);
 }
 
 template<typename T>
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <string>
+
+// Min/max mipmap of decoded audio. Level 0 keeps one min/max pair per BASE samples and every following level reduces
+// the one below by FACTOR, so an hour of 44.1 kHz audio needs about 3 MB and any zoom level draws in O(width).
+class Waveform
+{
+public:
+    static constexpr size_t BASE = 256, FACTOR = 4;
+
+    struct Bucket
+    {
+        int16_t min, max;
+    };
+
+    // While a Capture is alive, analysers created on the same thread also feed their samples into the waveform.
+    class Capture
+    {
+    public:
+        Capture(Waveform &waveform, double startMs);
+        ~Capture();
+    };
+
+    static Waveform* current();
+
+    void reset(long sampleRate, double startMs);
+    void begin(long sampleRate);
+    void push(int sample)
+    {
+        min = std::min(min, sample);
+        max = std::max(max, sample);
+        if (++count == BASE) flush();
+    }
+    void finish();
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    [[nodiscard]] bool empty() const { return levels.empty() || levels.front().empty(); }
+    [[nodiscard]] size_t bytes() const;
+
+    [[nodiscard]] const std::vector<std::vector<Bucket>> &pyramid() const { return levels; }
+    [[nodiscard]] long sampleRate() const { return rate; }
+    [[nodiscard]] double startMs() const { return start; }
+
+private:
+    void flush();
+
+    std::vector<std::vector<Bucket>> levels;
+    long rate = 0;
+    double start = 0;
+    int min = INT16_MAX, max = INT16_MIN;
+    size_t count = 0;
+};
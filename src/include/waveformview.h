@@ -0,0 +1,11 @@
+#pragma once
+
+#include "waveform.h"
+
+// Draws a Waveform as a 100px panel, scrolled and zoomed like the piano roll above it. Each pixel column is drawn
+// from the coarsest pyramid level that still resolves it, so drawing costs O(width) at any zoom.
+class WaveformView
+{
+public:
+    static void draw(const Waveform &waveform, double scroll, double msPerPixel);
+};
@@ -0,0 +1,163 @@
+#include "include/journal.h"
+
+#include <algorithm>
+
+void Journal::record(Entry entry)
+{
+    entry.linked = linkNext;
+    linkNext = false;
+    undoEntries.push_back(entry);
+    redoEntries.clear();
+    redoNotes.clear();
+
+    while (undoEntries.size() > limit)
+    {
+        // Only erasures keep notes on the undo stack, and the oldest entry's notes are the oldest on it.
+        auto &oldest = undoEntries.front();
+        if (oldest.kind == ERASE) undoNotes.erase(undoNotes.begin(), undoNotes.begin() + oldest.count);
+        undoEntries.pop_front();
+    }
+}
+
+void Journal::set(size_t index, std::pair<int, int> note)
+{
+    if (open && undoEntries.back().kind == SET && undoEntries.back().first == index)
+    {
+        undoEntries.back().after = note;
+        redoEntries.clear();
+        redoNotes.clear();
+    }
+    else
+    {
+        record({SET, false, static_cast<uint32_t>(index), 1, 0, data[index], note});
+        open = true;
+    }
+
+    data.set(index, note);
+}
+
+void Journal::swap(size_t index)
+{
+    open = false;
+    Entry entry = {SWAP, false, static_cast<uint32_t>(index), 2, 0, {}, {}};
+    Notes none;
+    apply(entry, true, none, none);
+    record(entry);
+}
+
+void Journal::rotate(size_t first, size_t middle, size_t last)
+{
+    open = false;
+    data.rotate(first, middle, last);
+    record({ROTATE, false, static_cast<uint32_t>(first), static_cast<uint32_t>(last - first),
+            static_cast<uint32_t>(middle - first), {}, {}});
+}
+
+void Journal::erase(size_t first, size_t last)
+{
+    if (first >= last) return;
+
+    open = false;
+    Entry entry = {ERASE, false, static_cast<uint32_t>(first), static_cast<uint32_t>(last - first), 0, {}, {}};
+    Notes none;
+    apply(entry, true, none, undoNotes);
+    record(entry);
+}
+
+void Journal::appended(size_t first)
+{
+    if (first >= data.size()) return;
+
+    open = false;
+    record({INSERT, false, static_cast<uint32_t>(first), static_cast<uint32_t>(data.size() - first), 0, {}, {}});
+}
+
+// Applies `entry` forwards (redo) or backwards (undo). Notes that leave the sequence are pushed onto `to`, notes that
+// come back are popped from the end of `from`.
+void Journal::apply(const Entry &entry, bool forward, Notes &from, Notes &to)
+{
+    auto first = entry.first, last = entry.first + entry.count;
+
+    switch (entry.kind)
+    {
+        case SET:
+            data.set(first, forward ? entry.after : entry.before);
+            break;
+        case SWAP:
+        {
+            auto note = data[first];
+            data.set(first, data[first + 1]);
+            data.set(first + 1, note);
+            break;
+        }
+        case ROTATE:
+            data.rotate(first, first + (forward ? entry.shift : entry.count - entry.shift), last);
+            break;
+        case ERASE:
+        case INSERT:
+            if ((entry.kind == ERASE) == forward)
+            {
+                auto notes = data.copy(first, last);
+                to.insert(to.end(), notes.begin(), notes.end());
+                data.erase(first, last);
+            }
+            else
+            {
+                std::vector<std::pair<int, int>> notes(from.end() - entry.count, from.end());
+                data.insert(first, notes.data(), notes.size());
+                from.erase(from.end() - entry.count, from.end());
+            }
+            break;
+    }
+}
+
+bool Journal::undo()
+{
+    if (undoEntries.empty()) return false;
+
+    open = false;
+    bool linked;
+    do
+    {
+        auto entry = undoEntries.back();
+        undoEntries.pop_back();
+        linked = entry.linked;
+
+        apply(entry, false, undoNotes, redoNotes);
+        redoEntries.push_back(entry);
+    } while (linked && !undoEntries.empty());
+
+    return true;
+}
+
+bool Journal::redo()
+{
+    if (redoEntries.empty()) return false;
+
+    open = false;
+    do
+    {
+        auto entry = redoEntries.back();
+        redoEntries.pop_back();
+
+        apply(entry, true, redoNotes, undoNotes);
+        undoEntries.push_back(entry);
+    } while (!redoEntries.empty() && redoEntries.back().linked);
+
+    return true;
+}
+
+void Journal::clear()
+{
+    undoEntries.clear();
+    redoEntries.clear();
+    undoNotes.clear();
+    redoNotes.clear();
+    open = linkNext = false;
+}
+
+size_t Journal::bytes() const
+{
+    return (undoEntries.size() + redoEntries.size()) * sizeof(Entry) +
+           (undoNotes.size() + redoNotes.size()) * sizeof(std::pair<int, int>);
+}
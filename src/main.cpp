@@ -1,11 +1,7 @@
 #include <vector>
-#include <chrono>
-#include <thread>
+#include <mutex>
 
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <linux/kd.h>
 
 #include <SDL2/SDL.h>
 
@@ -15,29 +11,71 @@
 
 #include "include/utils.h"
 #include "include/audio.h"
-
-std::vector<std::pair<int, int>> data;
+#include "include/batch.h"
+#include "include/presets.h"
+#include "include/pianoroll.h"
+#include "include/waveform.h"
+#include "include/waveformview.h"
+#include "include/player.h"
+#include "include/overlay.h"
+#include "include/metrics.h"
+#include "include/trace.h"
+#include "include/journal.h"
+#include "include/snapshot.h"
+
+int WIDTH = 1366, HEIGHT = 768;
+NoteSequence data;
 static char audioDevice[256] = "/dev/console";
-bool isPlaying = false, isDragging = false;
-int currentFreq = 0, draggedIndex = -1;
+bool isDragging = false;
+int draggedIndex = -1;
+size_t playbackStart = 0;
+unsigned int revision = 0;
+PianoRoll pianoRoll;
+Waveform waveform;
+Journal journal(data);
+
+// The player reads the latest published version of `data`; edits are published once per frame.
+SnapshotStore snapshots;
+unsigned int publishedRevision = 0;
+
+void publish()
+{
+    if (publishedRevision == revision) return;
+
+    snapshots.publish(data);
+    publishedRevision = revision;
+}
+
+// Posted by background work to wake the render loop while it is blocked waiting for input.
+Uint32 wakeEvent = 0;
+
+void wake()
+{
+    SDL_Event event{};
+    event.type = wakeEvent;
+    SDL_PushEvent(&event);
+}
+
+Player player(wake);
+
+// Errors can be reported from any thread; the next frame shows the latest one in a popup.
+std::mutex errorMutex;
+std::string pendingError, errorMessage;
 
-void beep(int fd, int frequency, int duration)
+void showError(const std::string &message)
 {
-    if (frequency == 0)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(duration));
-        return;
+        std::lock_guard lock(errorMutex);
+        pendingError = message;
     }
 
-    check(fd);
-    check(ioctl(fd, KIOCSOUND, static_cast<int>(CLOCK_RATE / frequency)));
-    std::this_thread::sleep_for(std::chrono::milliseconds(duration));
-    check(ioctl(fd, KIOCSOUND, 0));
+    wake();
 }
 
 SDL_Window* init()
 {
     check(SDL_Init(SDL_INIT_VIDEO));
+    wakeEvent = SDL_RegisterEvents(1);
 
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -63,6 +101,9 @@ SDL_Window* init()
         exit(EXIT_FAILURE);
     }
 
+    // Let the swap block on vertical sync instead of spinning through frames nobody sees.
+    if (SDL_GL_SetSwapInterval(1) != 0) std::clog << "VSync unavailable: " << SDL_GetError() << std::endl;
+
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGui::GetIO().IniFilename = nullptr;
@@ -70,6 +111,7 @@ SDL_Window* init()
     ImGui_ImplSDL2_InitForOpenGL(window, context);
     ImGui_ImplOpenGL3_Init("#version 330 core");
     ImGui::StyleColorsDark();
+    errorHandler = showError;
 
     SDL_AddEventWatch([](void*, SDL_Event* event) -> int
                       {
@@ -85,7 +127,20 @@ SDL_Window* init()
     return window;
 }
 
-void addImportButton(const std::string &label, void (* callback)(std::vector<std::pair<int, int>> &, const char*))
+void appendNotes(const std::vector<std::pair<int, int>> &notes)
+{
+    auto offset = data.size();
+    data.append(notes);
+    journal.appended(offset);
+}
+
+double totalDuration()
+{
+    return std::accumulate(data.begin(), data.end(), 0.0, [](double total, auto &note) { return total + note.second; });
+}
+
+void addImportButton(const std::string &label, bool (* callback)(std::vector<std::pair<int, int>> &, const char*),
+                     bool capture = false)
 {
     if (ImGui::Button(label.c_str())) ImGui::OpenPopup(label.c_str());
     if (ImGui::BeginPopup(label.c_str()))
@@ -96,7 +151,16 @@ void addImportButton(const std::string &label, void (* callback)(std::vector<std
         if (label == "Import CSV") ImGui::Checkbox("Skip Header", &AudioManager::skipHeader);
         if (ImGui::Button("OK"))
         {
-            callback(data, path);
+            std::vector<std::pair<int, int>> notes;
+            if (capture)
+            {
+                Waveform::Capture waveformCapture(waveform, totalDuration());
+                callback(notes, path);
+            }
+            else callback(notes, path);
+
+            appendNotes(notes);
+            ++revision;
             ImGui::CloseCurrentPopup();
         }
 
@@ -125,196 +189,275 @@ void drawToneGenerator()
             std::string keyLabel = std::string(pianoKeyLabels[i]) + std::to_string(octave + startingOctave);
 
             if (ImGui::Button(keyLabel.c_str(), ImVec2(35, 35)))
-                data.emplace_back(static_cast<int>(std::round(frequency)), duration);
+            {
+                appendNotes({{static_cast<int>(std::round(frequency)), duration}});
+                ++revision;
+            }
 
             ImGui::PopID();
             if ((i + 1) % 12 != 0) ImGui::SameLine();
         }
 }
 
+void undo(bool redo)
+{
+    if (!(redo ? journal.redo() : journal.undo())) return;
+
+    playbackStart = std::min(playbackStart, data.size());
+    ++revision;
+}
+
 void drawGUI(SDL_Window* window)
 {
+    TRACE_SCOPE("drawGUI");
+    static auto &frameTime = Metrics::histogram("frame.cpu_us");
+    static auto &vertices = Metrics::gauge("imgui.vertices"), &indices = Metrics::gauge("imgui.indices");
+    static auto &notesBytes = Metrics::gauge("memory.notes_bytes");
+    static auto &waveformBytes = Metrics::gauge("memory.waveform_bytes");
+    static auto &journalBytes = Metrics::gauge("memory.journal_bytes");
+    auto frameStart = std::chrono::steady_clock::now();
+
+    notesBytes.set(static_cast<int64_t>(data.bytes()));
+    waveformBytes.set(static_cast<int64_t>(waveform.bytes()));
+    journalBytes.set(static_cast<int64_t>(journal.bytes()));
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame(window);
     ImGui::NewFrame();
 
     ImGui::Begin("SoundTest", nullptr,
-                 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+                 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
+                 ImGuiWindowFlags_NoBringToFrontOnFocus);
     ImGui::SetWindowPos(ImVec2(0, 0));
     ImGui::SetWindowSize(ImVec2(static_cast<float>(WIDTH), static_cast<float>(HEIGHT)));
 
     ImGui::SeparatorText("Controls");
-    if (ImGui::Button("Play")) isPlaying = true;
+    if (ImGui::Button("Play"))
+    {
+        publish();
+        player.play(snapshots, playbackStart, audioDevice);
+    }
     ImGui::SameLine();
-    if (ImGui::Button("Stop")) isPlaying = false;
+    ImGui::BeginDisabled(!player.playing());
+    if (ImGui::Button(player.paused() ? "Resume" : "Pause", ImVec2(60, 0)))
+    {
+        if (player.paused()) player.resume();
+        else player.pause();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Stop")) player.stop();
     ImGui::SameLine();
     if (ImGui::Button("Clear"))
     {
-        data.clear();
-        isPlaying = false;
+        journal.erase(0, data.size());
+        waveform.reset(0, 0);
+        player.stop();
+        playbackStart = 0;
+        ++revision;
     }
     ImGui::SameLine();
     ImGui::TextColored(ImVec4(0.43f, 0.43f, 0.50f, 0.50f), "|");
     ImGui::SameLine();
     if (ImGui::BeginCombo("Presets", "None"))
     {
-        if (ImGui::Selectable("Für Elise - Beethoven"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/fur_elise.csv");
-        }
-
-        if (ImGui::Selectable("Tetris Theme (Korobeiniki)"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/tetris.csv");
-        }
-
-        if (ImGui::Selectable("Axel F - Harold Faltermeyer"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/axel_f.csv");
-        }
-
-        if (ImGui::Selectable("Super Mario Bros. Theme - Koji Kondo"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/mario.csv");
-        }
-
-        if (ImGui::Selectable("Pink Panther Theme - Henry Mancini"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/pink_panther.csv");
-        }
-
-        if (ImGui::Selectable("Memories - Maroon 5"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/memories.csv");
-        }
-
-        if (ImGui::Selectable("Shape of You - Ed Sheeran"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/shape_of_you.csv");
-        }
-
-        if (ImGui::Selectable("Nokia Tune - Francisco Tárrega"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/nokia.csv");
-        }
-
-        if (ImGui::Selectable("Happy Birthday - Patty Hill"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/happy_birthday.csv");
-        }
-
-        if (ImGui::Selectable("Harry Potter Theme - John Williams"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/harry_potter.csv");
-        }
-
-        if (ImGui::Selectable("Star Wars Theme - John Williams"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/star_wars.csv");
-        }
+        for (size_t i = 0; i < PRESET_COUNT; ++i)
+            if (ImGui::Selectable(PRESETS[i].name))
+            {
+                if (!data.empty())
+                {
+                    journal.erase(0, data.size());
+                    journal.link();
+                }
+                data.insert(0, PRESETS[i].notes, PRESETS[i].size);
+                journal.appended(0);
+                waveform.reset(0, 0);
+                playbackStart = 0;
+                ++revision;
+            }
 
-        if (ImGui::Selectable("Pirates of the Caribbean Theme - Klaus Badelt"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/pirates_of_the_caribbean.csv");
-        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::TextColored(ImVec4(0.43f, 0.43f, 0.50f, 0.50f), "|");
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!journal.canUndo());
+    if (ImGui::Button("Undo")) undo(false);
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!journal.canRedo());
+    if (ImGui::Button("Redo")) undo(true);
+    ImGui::EndDisabled();
 
-        if (ImGui::Selectable("At Doom's Gate - Bobby Prince"))
-        {
-            data.clear();
-            AudioManager::importCSV(data, "lib/res/doom.csv");
-        }
+    if (!ImGui::GetIO().WantTextInput)
+    {
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Shortcut | ImGuiKey_Z)) undo(false);
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Shortcut | ImGuiKey_Y) ||
+            ImGui::IsKeyChordPressed(ImGuiMod_Shortcut | ImGuiMod_Shift | ImGuiKey_Z)) undo(true);
+    }
 
-        ImGui::EndCombo();
+    // Tempo and transposition are applied by the player as each note starts, so moving them never touches the notes.
+    auto tempo = player.tempo();
+    auto transpose = player.transpose();
+    ImGui::PushItemWidth(200);
+    if (ImGui::SliderFloat("Tempo", &tempo, Player::MIN_TEMPO, Player::MAX_TEMPO, "%.2fx",
+                           ImGuiSliderFlags_Logarithmic))
+        player.setTempo(tempo);
+    ImGui::SameLine();
+    if (ImGui::SliderInt("Transpose", &transpose, -Player::MAX_TRANSPOSE, Player::MAX_TRANSPOSE, "%+d st"))
+        player.setTranspose(transpose);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+    {
+        player.setTempo(1.0f);
+        player.setTranspose(0);
     }
 
     ImGui::SeparatorText("Import/Export");
-    addImportButton("Import WAV", AudioManager::importWAV);
+    addImportButton("Import WAV", AudioManager::importWAV, true);
     ImGui::SameLine();
     addImportButton("Import MIDI", AudioManager::importMIDI);
     ImGui::SameLine();
-    addImportButton("Import MP3", AudioManager::importMP3);
+    addImportButton("Import MP3", AudioManager::importMP3, true);
     ImGui::SameLine();
     addImportButton("Import CSV", AudioManager::importCSV);
     ImGui::SameLine();
+    addImportButton("Import Binary", AudioManager::importBinary);
+    ImGui::SameLine();
+    addImportButton("Import Archive", AudioManager::importArchive);
+    ImGui::SameLine();
     if (ImGui::Button("Import from SoundCloud")) ImGui::OpenPopup("Import from SoundCloud");
     ImGui::SameLine();
-    if (ImGui::Button("Export CSV")) AudioManager::exportCSV(data, "sound_data.csv");
+    auto exportButton = [](const char* label, bool (* exporter)(std::vector<std::pair<int, int>> &, const char*),
+                           const char* path)
+    {
+        if (!ImGui::Button(label)) return;
+
+        auto notes = data.toVector();
+        exporter(notes, path);
+    };
+    exportButton("Export CSV", AudioManager::exportCSV, "sound_data.csv");
+    ImGui::SameLine();
+    exportButton("Export Binary", AudioManager::exportBinary, "sound_data.stn");
+    ImGui::SameLine();
+    exportButton("Export Archive", AudioManager::exportArchive, "sound_data.stz");
 
     ImGui::SeparatorText("Tone Generator");
     drawToneGenerator();
-    if (!data.empty()) ImGui::SeparatorText("Sound Data");
-
-    for (auto i = 0; i < static_cast<int>(data.size()); ++i)
+    if (!data.empty())
     {
-        auto &[freq, duration] = data[i];
+        ImGui::SeparatorText("Timeline");
+        if (pianoRoll.draw(data, revision, playbackStart, player.note()) && player.playing())
+            player.seek(playbackStart);
+        if (!waveform.empty()) WaveformView::draw(waveform, pianoRoll.viewStart(), pianoRoll.viewScale());
+        ImGui::SeparatorText("Sound Data");
+    }
 
-        ImGui::PushID(i);
-        ImGui::PushItemWidth(static_cast<float>(WIDTH) / 3);
+    // Only the rows in view are submitted, so the list costs the same for ten notes or a million.
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(data.size()));
+    while (clipper.Step())
+        for (auto i = clipper.DisplayStart; i < std::min(clipper.DisplayEnd, static_cast<int>(data.size())); ++i)
+        {
+            auto note = data[i];
 
-        ImGui::SliderInt("Frequency", &freq, 0, 1000);
-        ImGui::SameLine();
-        ImGui::SliderInt("Duration", &duration, 0, 1000);
+            ImGui::PushID(i);
+            ImGui::PushItemWidth(static_cast<float>(WIDTH) / 3);
 
-        ImGui::SameLine();
-        ImGui::Text(" ");
-        if (i > 0)
-        {
+            // A slider drag is journaled as one edit, sealed when the slider is released.
+            if (ImGui::SliderInt("Frequency", &note.first, 0, 1000))
+            {
+                journal.set(i, note);
+                pianoRoll.set(i, note, ++revision);
+            }
+            if (ImGui::IsItemDeactivated()) journal.seal();
             ImGui::SameLine();
-            if (ImGui::SmallButton("^##up")) std::swap(data[i], data[i - 1]);
-        }
+            if (ImGui::SliderInt("Duration", &note.second, 0, 1000))
+            {
+                journal.set(i, note);
+                pianoRoll.set(i, note, ++revision);
+            }
+            if (ImGui::IsItemDeactivated()) journal.seal();
 
-        if (i < static_cast<int>(data.size()) - 1)
-        {
             ImGui::SameLine();
-            if (ImGui::SmallButton("v##down")) std::swap(data[i], data[i + 1]);
-        }
+            ImGui::Text(" ");
+            if (i > 0)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton("^##up"))
+                {
+                    journal.swap(i - 1);
+                    ++revision;
+                }
+            }
 
-        ImGui::SameLine();
-        if (ImGui::Button("Delete")) data.erase(data.begin() + i);
+            if (i < static_cast<int>(data.size()) - 1)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton("v##down"))
+                {
+                    journal.swap(i);
+                    ++revision;
+                }
+            }
 
-        if (ImGui::IsMouseReleased(0) && isDragging && draggedIndex != -1)
-        {
-            isDragging = false;
-            if (draggedIndex != i)
-                std::rotate(data.begin() + std::min(i, draggedIndex), data.begin() + draggedIndex,
-                            data.begin() + std::max(i, draggedIndex) + 1);
-        }
+            ImGui::SameLine();
+            if (ImGui::Button("Delete"))
+            {
+                journal.erase(i, i + 1);
+                ++revision;
+            }
 
-        if (ImGui::IsItemActive() && !isDragging)
-        {
-            draggedIndex = i;
-            isDragging = true;
-        }
+            if (ImGui::IsMouseReleased(0) && isDragging && draggedIndex != -1)
+            {
+                isDragging = false;
+                if (draggedIndex != i)
+                {
+                    journal.rotate(std::min(i, draggedIndex), draggedIndex, std::max(i, draggedIndex) + 1);
+                    ++revision;
+                }
+            }
 
-        ImGui::PopItemWidth();
-        ImGui::PopID();
-    }
+            if (ImGui::IsItemActive() && !isDragging)
+            {
+                draggedIndex = i;
+                isDragging = true;
+            }
+
+            ImGui::PopItemWidth();
+            ImGui::PopID();
+        }
 
     ImGui::SeparatorText("Settings");
 
     ImGui::InputText("Audio Device", audioDevice, sizeof(audioDevice));
-    ImGui::Text("Currently Playing: %d Hz", currentFreq);
+    ImGui::Checkbox("Cache Imports", &ImportCache::enabled);
+    ImGui::Checkbox("Performance Overlay (F3)", &PerformanceOverlay::visible);
+
+    auto tracing = Trace::enabled.load();
+    if (ImGui::Checkbox("Record Trace", &tracing)) Trace::enabled = tracing;
+    ImGui::SameLine();
+    if (ImGui::Button("Save Trace")) Trace::write("soundtest-trace.json");
+    ImGui::Text("Currently Playing: %d Hz", player.frequency());
 
     if (ImGui::BeginPopup("Import from SoundCloud"))
     {
-        static char id[256];
-        ImGui::InputText("SoundCloud ID", id, sizeof(id));
+        static char id[1024];
+        ImGui::InputText("SoundCloud IDs", id, sizeof(id));
 
         if (ImGui::Button("OK"))
         {
-            AudioManager::importSoundCloud(data, id);
+            std::vector<std::pair<int, int>> notes;
+            if (strchr(id, ',')) AudioManager::importSoundCloudPlaylist(notes, id);
+            else
+            {
+                Waveform::Capture waveformCapture(waveform, totalDuration());
+                AudioManager::importSoundCloud(notes, id);
+            }
+
+            appendNotes(notes);
+            ++revision;
             ImGui::CloseCurrentPopup();
         }
 
@@ -323,13 +466,45 @@ void drawGUI(SDL_Window* window)
         ImGui::EndPopup();
     }
 
+    {
+        std::lock_guard lock(errorMutex);
+        if (!pendingError.empty())
+        {
+            errorMessage = std::move(pendingError);
+            pendingError.clear();
+            ImGui::OpenPopup("Error");
+        }
+    }
+
+    if (ImGui::BeginPopup("Error"))
+    {
+        ImGui::Text("%s", errorMessage.c_str());
+        if (ImGui::Button("OK")) ImGui::CloseCurrentPopup();
+        ImGui::EndPopup();
+    }
+
     ImGui::End();
+    PerformanceOverlay::draw();
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    vertices.set(ImGui::GetDrawData()->TotalVtxCount);
+    indices.set(ImGui::GetDrawData()->TotalIdxCount);
+    frameTime.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                            frameStart).count());
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    TRACE_THREAD("main");
+    if (argc > 1)
+    {
+        auto result = BatchConverter::runCommandLine(argc, argv);
+        Trace::flush();
+        return result;
+    }
+
     if (geteuid() != 0)
     {
         error("Please run this program as root!");
@@ -337,38 +512,40 @@ int main()
     }
 
     SDL_Window* window = init();
-    bool running = true;
+    bool running = true, wasPlaying = false;
+    int pendingFrames = 2;
 
     while (running)
     {
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
-        {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT) running = false;
-        }
+        // ImGui needs a couple of frames to settle after any input, and keeps redrawing while something is being
+        // dragged. Otherwise nothing changes until the next event, so block instead of spinning.
+        auto animating = pendingFrames > 0 || isDragging || ImGui::IsAnyItemActive();
+        auto timeout = ImGui::GetIO().WantTextInput ? 250 : 1000;
 
-        drawGUI(window);
-        SDL_GL_SwapWindow(window);
-        SDL_RenderPresent(SDL_GetRenderer(window));
-
-        if (isPlaying)
+        SDL_Event event;
+        if (animating ? SDL_PollEvent(&event) : SDL_WaitEventTimeout(&event, timeout))
         {
-            int fd = open(audioDevice, O_WRONLY);
-            for (const auto &[freq, duration]: data)
+            do
             {
-                if (!isPlaying) break;
+                ImGui_ImplSDL2_ProcessEvent(&event);
+                if (event.type == SDL_QUIT) running = false;
+            } while (SDL_PollEvent(&event));
 
-                currentFreq = freq;
-                beep(fd, freq, duration);
-            }
+            pendingFrames = 2;
+        } else if (pendingFrames > 0) --pendingFrames;
 
-            close(fd);
-            currentFreq = 0;
-            isPlaying = false;
-        }
+        TRACE_SCOPE("frame");
+        if (wasPlaying && !player.playing()) playbackStart = 0;
+        wasPlaying = player.playing();
+
+        drawGUI(window);
+        publish();
+        TRACE_SCOPE("swap");
+        SDL_GL_SwapWindow(window);
     }
 
+    player.stop();
+    Trace::flush();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,154 @@
+#include "include/metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <thread>
+
+std::array<Metrics::Slot, 64> Metrics::slots;
+std::atomic<const char*> Metrics::lastImporter = nullptr;
+
+static thread_local struct
+{
+    int stage = -1;
+    std::chrono::steady_clock::time_point since;
+    std::array<std::chrono::steady_clock::duration, Metrics::STAGES> spent{};
+} stageClock;
+
+static constexpr const char* STAGE_NAMES[] = {"read", "decode", "analyse", "emit"};
+
+static size_t bucketOf(uint64_t value)
+{
+    if (value < 4) return value;
+
+    auto top = 63 - std::countl_zero(value);
+    return std::min(static_cast<size_t>((top - 1) * 4 + ((value >> (top - 2)) & 3)), Metrics::Histogram::BUCKETS - 1);
+}
+
+static uint64_t bucketLimit(size_t bucket)
+{
+    if (bucket < 4) return bucket;
+
+    auto top = bucket / 4 + 1;
+    return ((4 + bucket % 4) << (top - 2)) + (1ULL << (top - 2)) - 1;
+}
+
+void Metrics::Histogram::record(uint64_t value)
+{
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    latest[position.fetch_add(1, std::memory_order_relaxed) % RECENT].store(static_cast<float>(value),
+                                                                            std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+
+    auto seen = largest.load(std::memory_order_relaxed);
+    while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed));
+}
+
+void Metrics::Histogram::reset()
+{
+    for (auto &bucket: buckets) bucket.store(0, std::memory_order_relaxed);
+    for (auto &value: latest) value.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    largest.store(0, std::memory_order_relaxed);
+    position.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Histogram::percentile(double fraction) const
+{
+    uint64_t counted = 0;
+    for (auto &bucket: buckets) counted += bucket.load(std::memory_order_relaxed);
+    if (counted == 0) return 0;
+
+    // Report the upper edge of the bucket holding the requested rank, capped at the largest value actually seen.
+    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(counted - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketLimit(i), max());
+    }
+
+    return max();
+}
+
+void Metrics::Histogram::recent(float (&values)[RECENT]) const
+{
+    // Oldest first, so the values can be plotted left to right.
+    auto next = position.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < RECENT; ++i) values[i] = latest[(next + i) % RECENT].load(std::memory_order_relaxed);
+}
+
+Metrics::Slot &Metrics::find(const char* name, Kind kind)
+{
+    for (auto &slot: slots)
+    {
+        int state = EMPTY;
+        if (slot.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acquire))
+        {
+            slot.name = name;
+            slot.kind = kind;
+            slot.state.store(READY, std::memory_order_release);
+            return slot;
+        }
+
+        // The slot is taken, possibly still being registered by another thread; once published, check if it is ours.
+        while (state != READY)
+        {
+            std::this_thread::yield();
+            state = slot.state.load(std::memory_order_acquire);
+        }
+
+        if (slot.kind == kind && std::strcmp(slot.name, name) == 0) return slot;
+    }
+
+    // The registry is sized for every metric in the program, so running out is a programming error. Hand out a
+    // scratch slot rather than failing, since metrics must never take the caller down.
+    static thread_local Slot overflow;
+    return overflow;
+}
+
+Metrics::Gauge &Metrics::gauge(const char* name) { return find(name, GAUGE).gauge; }
+
+Metrics::Histogram &Metrics::histogram(const char* name) { return find(name, HISTOGRAM).histogram; }
+
+Metrics::StageTimer::StageTimer(Stage stage) : previous(stageClock.stage)
+#ifdef SOUNDTEST_TRACING
+    , span(STAGE_NAMES[stage])
+#endif
+{
+    auto now = std::chrono::steady_clock::now();
+    if (previous >= 0) stageClock.spent[previous] += now - stageClock.since;
+
+    stageClock.stage = stage;
+    stageClock.since = now;
+}
+
+Metrics::StageTimer::~StageTimer()
+{
+    auto now = std::chrono::steady_clock::now();
+    stageClock.spent[stageClock.stage] += now - stageClock.since;
+
+    stageClock.stage = previous;
+    stageClock.since = now;
+}
+
+Metrics::ImportScope::ImportScope(const char* importer) : importer(importer), started(std::chrono::steady_clock::now())
+{
+    stageClock.spent.fill({});
+}
+
+Metrics::ImportScope::~ImportScope()
+{
+    using std::chrono::microseconds, std::chrono::duration_cast;
+
+    static auto &read = gauge("import.read_us"), &decode = gauge("import.decode_us");
+    static auto &analyse = gauge("import.analyse_us"), &emit = gauge("import.emit_us");
+    static auto &total = gauge("import.total_us");
+
+    read.set(duration_cast<microseconds>(stageClock.spent[READ]).count());
+    decode.set(duration_cast<microseconds>(stageClock.spent[DECODE]).count());
+    analyse.set(duration_cast<microseconds>(stageClock.spent[ANALYSE]).count());
+    emit.set(duration_cast<microseconds>(stageClock.spent[EMIT]).count());
+    total.set(duration_cast<microseconds>(std::chrono::steady_clock::now() - started).count());
+    lastImporter.store(importer, std::memory_order_relaxed);
+}
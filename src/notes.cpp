@@ -0,0 +1,180 @@
+#include "include/notes.h"
+
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/utils.h"
+
+static_assert(std::endian::native == std::endian::little, "Note files are mapped in place and are little-endian");
+
+static uint64_t align(uint64_t offset) { return (offset + NoteFileHeader::ALIGNMENT - 1) & ~(NoteFileHeader::ALIGNMENT - 1); }
+
+NoteView::NoteView(NoteView &&other) noexcept { *this = std::move(other); }
+
+NoteView &NoteView::operator=(NoteView &&other) noexcept
+{
+    if (this == &other) return *this;
+    close();
+
+    std::swap(mapping, other.mapping);
+    std::swap(mappingSize, other.mappingSize);
+    std::swap(header, other.header);
+    std::swap(frequency, other.frequency);
+    std::swap(duration, other.duration);
+    std::swap(start, other.start);
+
+    return *this;
+}
+
+NoteView::~NoteView() { close(); }
+
+bool NoteView::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(NoteFileHeader))
+    {
+        error("Invalid note file! File is too small to hold a header.");
+        ::close(fd);
+        return false;
+    }
+
+    mappingSize = static_cast<size_t>(info.st_size);
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        error("Failed to map file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    auto base = static_cast<const char*>(mapping);
+    auto candidate = reinterpret_cast<const NoteFileHeader*>(base);
+    auto fits = [&](uint64_t offset, uint64_t width)
+    {
+        return offset % NoteFileHeader::ALIGNMENT == 0 && offset <= mappingSize &&
+               candidate->count <= (mappingSize - offset) / width;
+    };
+
+    if (std::memcmp(candidate->magic, NoteFileHeader::MAGIC, sizeof(NoteFileHeader::MAGIC)) != 0)
+    {
+        error("Invalid note file! Missing STNB header.");
+        close();
+        return false;
+    }
+    if (candidate->version != NoteFileHeader::VERSION)
+    {
+        error("Unsupported note file version! Found version " + std::to_string(candidate->version) + ".");
+        close();
+        return false;
+    }
+    if (!fits(candidate->frequencyOffset, sizeof(int32_t)) || !fits(candidate->durationOffset, sizeof(int32_t)) ||
+        !fits(candidate->startOffset, sizeof(int64_t)))
+    {
+        error("Invalid note file! Column offsets are out of range.");
+        close();
+        return false;
+    }
+
+    header = candidate;
+    frequency = reinterpret_cast<const int32_t*>(base + header->frequencyOffset);
+    duration = reinterpret_cast<const int32_t*>(base + header->durationOffset);
+    start = reinterpret_cast<const int64_t*>(base + header->startOffset);
+
+    // Playback reads the columns front to back.
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+void NoteView::close()
+{
+    if (mapping) munmap(mapping, mappingSize);
+
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    frequency = duration = nullptr;
+    start = nullptr;
+}
+
+bool NoteView::write(const std::vector<std::pair<int, int>> &data, const char* path)
+{
+    NoteFileHeader header = {};
+    std::memcpy(header.magic, NoteFileHeader::MAGIC, sizeof(header.magic));
+    header.version = NoteFileHeader::VERSION;
+    header.count = data.size();
+    header.frequencyOffset = align(sizeof(NoteFileHeader));
+    header.durationOffset = align(header.frequencyOffset + data.size() * sizeof(int32_t));
+    header.startOffset = align(header.durationOffset + data.size() * sizeof(int32_t));
+
+    std::vector<int32_t> frequencies(data.size()), durations(data.size());
+    std::vector<int64_t> starts(data.size());
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        frequencies[i] = data[i].first;
+        durations[i] = data[i].second;
+        starts[i] = static_cast<int64_t>(header.totalDuration);
+        header.totalDuration += static_cast<uint64_t>(std::max(data[i].second, 0));
+    }
+
+    // Written under a private name and renamed over `path`, so a process that has the old file mapped keeps reading
+    // the old pages rather than faulting on a file truncated under it.
+    auto temporary = std::string(path) + "." + std::to_string(getpid()) + "." +
+                     std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file.is_open())
+        {
+            error("Failed to open file: " + std::string(strerror(errno)));
+            return false;
+        }
+
+        auto writeColumn = [&file](uint64_t offset, const void* column, size_t size)
+        {
+            static const char padding[NoteFileHeader::ALIGNMENT] = {};
+            file.write(padding, static_cast<long>(offset - static_cast<uint64_t>(file.tellp())));
+            file.write(static_cast<const char*>(column), static_cast<long>(size));
+        };
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeColumn(header.frequencyOffset, frequencies.data(), frequencies.size() * sizeof(int32_t));
+        writeColumn(header.durationOffset, durations.data(), durations.size() * sizeof(int32_t));
+        writeColumn(header.startOffset, starts.data(), starts.size() * sizeof(int64_t));
+        file.close();
+
+        if (!file)
+        {
+            error("Failed to write file: " + temporary);
+            unlink(temporary.c_str());
+            return false;
+        }
+    }
+
+    if (rename(temporary.c_str(), path) != 0)
+    {
+        error("Failed to replace " + std::string(path) + ": " + std::string(strerror(errno)));
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,101 @@
+#include "include/overlay.h"
+#include "include/metrics.h"
+
+#include <string>
+
+#include <imgui/imgui.h>
+
+bool PerformanceOverlay::visible = false;
+
+static void percentiles(const char* label, const Metrics::Histogram &histogram, double scale, const char* unit)
+{
+    ImGui::Text("%s p50 %.2f  p95 %.2f  p99 %.2f  max %.2f %s", label,
+                static_cast<double>(histogram.percentile(0.50)) * scale,
+                static_cast<double>(histogram.percentile(0.95)) * scale,
+                static_cast<double>(histogram.percentile(0.99)) * scale,
+                static_cast<double>(histogram.max()) * scale, unit);
+}
+
+static std::string bytes(int64_t size)
+{
+    const char* units[] = {"B", "KiB", "MiB", "GiB"};
+    auto value = static_cast<double>(size);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < std::size(units))
+    {
+        value /= 1024;
+        ++unit;
+    }
+
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f %s", value, units[unit]);
+    return text;
+}
+
+void PerformanceOverlay::draw()
+{
+    if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) visible = !visible;
+    if (!visible) return;
+
+    static auto &frame = Metrics::histogram("frame.cpu_us");
+    static auto &vertices = Metrics::gauge("imgui.vertices"), &indices = Metrics::gauge("imgui.indices");
+    static auto &read = Metrics::gauge("import.read_us"), &decode = Metrics::gauge("import.decode_us");
+    static auto &analyse = Metrics::gauge("import.analyse_us"), &emit = Metrics::gauge("import.emit_us");
+    static auto &total = Metrics::gauge("import.total_us");
+    static auto &jitter = Metrics::histogram("playback.jitter_us");
+    static auto &notes = Metrics::gauge("memory.notes_bytes"), &waveform = Metrics::gauge("memory.waveform_bytes");
+
+    auto viewport = ImGui::GetMainViewport();
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 10, viewport->WorkPos.y + 10),
+                            ImGuiCond_Always, ImVec2(1, 0));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (!ImGui::Begin("Performance", &visible, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                               ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        ImGui::End();
+        return;
+    }
+
+    float recent[Metrics::Histogram::RECENT];
+    frame.recent(recent);
+    for (auto &value: recent) value /= 1000.0f;
+
+    ImGui::SeparatorText("Frame");
+    percentiles("CPU", frame, 0.001, "ms");
+    ImGui::PlotHistogram("##frames", recent, static_cast<int>(std::size(recent)), 0, nullptr, 0.0f, 16.7f,
+                         ImVec2(360, 60));
+    ImGui::Text("%lld vertices, %lld indices", static_cast<long long>(vertices.value()),
+                static_cast<long long>(indices.value()));
+
+    ImGui::SeparatorText("Last Import");
+    if (auto importer = Metrics::lastImport())
+    {
+        auto ms = [](const Metrics::Gauge &gauge) { return static_cast<double>(gauge.value()) / 1000.0; };
+        ImGui::Text("%s: %.1f ms", importer, ms(total));
+        ImGui::Text("read %.1f  decode %.1f  analyse %.1f  emit %.1f ms", ms(read), ms(decode), ms(analyse), ms(emit));
+    } else ImGui::TextDisabled("No import yet");
+
+    ImGui::SeparatorText("Playback");
+    if (jitter.count()) percentiles("Jitter", jitter, 0.001, "ms");
+    else ImGui::TextDisabled("Not played yet");
+
+    ImGui::SeparatorText("Memory");
+    ImGui::Text("Notes %s, waveform %s", bytes(notes.value()).c_str(), bytes(waveform.value()).c_str());
+
+    // Anything else subsystems publish shows up here without the overlay having to know about it.
+    if (ImGui::TreeNode("All Metrics"))
+    {
+        Metrics::forEach([](const char* name, const Metrics::Gauge* gauge, const Metrics::Histogram* histogram)
+                         {
+                             if (gauge) ImGui::Text("%s = %lld", name, static_cast<long long>(gauge->value()));
+                             else
+                                 ImGui::Text("%s: n %llu, p50 %llu, p99 %llu", name,
+                                             static_cast<unsigned long long>(histogram->count()),
+                                             static_cast<unsigned long long>(histogram->percentile(0.50)),
+                                             static_cast<unsigned long long>(histogram->percentile(0.99)));
+                         });
+        ImGui::TreePop();
+    }
+
+    ImGui::End();
+}
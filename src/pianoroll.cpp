@@ -0,0 +1,192 @@
+#include "include/pianoroll.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+
+static constexpr float HEIGHT = 220.0f;
+static constexpr std::pair<int, int> EMPTY = {INT_MAX, INT_MIN};
+
+static float pitch(int frequency) { return 69.0f + 12.0f * std::log2(static_cast<float>(frequency) / 440.0f); }
+
+void PianoRoll::rebuild(const NoteSequence &data)
+{
+    // Rests (frequency 0) are left out of the pitch ranges.
+    leaves = data.size();
+    durations.assign(leaves + 1, 0);
+    tree.assign(2 * leaves, EMPTY);
+
+    size_t i = 0;
+    for (auto &[freq, duration]: data)
+    {
+        durations[i + 1] = std::max(duration, 0);
+        if (freq > 0) tree[leaves + i] = {freq, freq};
+        ++i;
+    }
+
+    for (size_t node = 1; node <= leaves; ++node)
+        if (auto parent = node + (node & -node); parent <= leaves) durations[parent] += durations[node];
+
+    for (auto i = leaves; i-- > 1;)
+        tree[i] = {std::min(tree[2 * i].first, tree[2 * i + 1].first),
+                   std::max(tree[2 * i].second, tree[2 * i + 1].second)};
+}
+
+void PianoRoll::set(size_t index, std::pair<int, int> note, unsigned int revision)
+{
+    if (!built || revision != builtRevision + 1 || index >= leaves) return;
+    builtRevision = revision;
+
+    auto delta = std::max(note.second, 0) - (start(index + 1) - start(index));
+    for (auto node = index + 1; delta != 0 && node <= leaves; node += node & -node) durations[node] += delta;
+
+    auto i = leaves + index;
+    tree[i] = note.first > 0 ? std::pair(note.first, note.first) : EMPTY;
+    for (i >>= 1; i >= 1; i >>= 1)
+        tree[i] = {std::min(tree[2 * i].first, tree[2 * i + 1].first),
+                   std::max(tree[2 * i].second, tree[2 * i + 1].second)};
+}
+
+int64_t PianoRoll::start(size_t index) const
+{
+    int64_t sum = 0;
+    for (; index > 0; index -= index & -index) sum += durations[index];
+    return sum;
+}
+
+std::pair<int, int> PianoRoll::pitchRange(size_t first, size_t last) const
+{
+    auto range = EMPTY;
+    for (first += leaves, last += leaves; first < last; first >>= 1, last >>= 1)
+    {
+        if (first & 1)
+        {
+            range = {std::min(range.first, tree[first].first), std::max(range.second, tree[first].second)};
+            ++first;
+        }
+        if (last & 1)
+        {
+            --last;
+            range = {std::min(range.first, tree[last].first), std::max(range.second, tree[last].second)};
+        }
+    }
+
+    return range;
+}
+
+size_t PianoRoll::noteAt(double time) const
+{
+    // Descends the Fenwick tree to the last note starting at or before `time`.
+    auto remaining = static_cast<int64_t>(std::max(time, 0.0));
+    size_t index = 0;
+    for (auto step = std::bit_floor(std::max<size_t>(leaves, 1)); step > 0; step >>= 1)
+        if (index + step <= leaves && durations[index + step] <= remaining)
+        {
+            index += step;
+            remaining -= durations[index];
+        }
+
+    return std::min(index, std::max<size_t>(leaves, 1) - 1);
+}
+
+bool PianoRoll::draw(const NoteSequence &data, unsigned int revision, size_t &cursor,
+                     size_t playing)
+{
+    if (!built || revision != builtRevision)
+    {
+        rebuild(data);
+        builtRevision = revision;
+        built = true;
+    }
+
+    auto origin = ImGui::GetCursorScreenPos();
+    auto width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    ImGui::InvisibleButton("PianoRoll", ImVec2(width, HEIGHT),
+                           ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
+
+    auto &io = ImGui::GetIO();
+    auto total = static_cast<double>(start(leaves));
+    bool seeked = false;
+
+    if (ImGui::IsItemHovered())
+    {
+        auto mouseTime = scroll + (io.MousePos.x - origin.x) * msPerPixel;
+        if (io.MouseWheel != 0)
+        {
+            msPerPixel = std::clamp(msPerPixel * std::pow(0.8, io.MouseWheel), 0.01, std::max(total / width, 10.0));
+            scroll = mouseTime - (io.MousePos.x - origin.x) * msPerPixel;
+        }
+
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !data.empty())
+        {
+            cursor = std::min(noteAt(mouseTime), data.size() - 1);
+            seeked = true;
+        }
+    }
+
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Right)) scroll -= io.MouseDelta.x * msPerPixel;
+    scroll = std::clamp(scroll, 0.0, std::max(total - width * msPerPixel, 0.0));
+
+    auto drawList = ImGui::GetWindowDrawList();
+    ImVec2 end(origin.x + width, origin.y + HEIGHT);
+    drawList->AddRectFilled(origin, end, IM_COL32(20, 20, 24, 255));
+    drawList->PushClipRect(origin, end, true);
+
+    auto overall = pitchRange(0, leaves);
+    if (overall.first <= overall.second)
+    {
+        auto low = pitch(overall.first) - 1, high = pitch(overall.second) + 1;
+        auto noteHeight = std::max(HEIGHT / (high - low), 2.0f);
+        auto y = [&](int frequency) { return origin.y + HEIGHT - (pitch(frequency) - low) / (high - low) * HEIGHT; };
+        auto x = [&](double time) { return origin.x + static_cast<float>((time - scroll) / msPerPixel); };
+
+        auto first = noteAt(scroll), last = std::min(noteAt(scroll + width * msPerPixel) + 1, data.size());
+        if (last - first <= static_cast<size_t>(width))
+        {
+            auto note = data.at(first);
+            auto time = start(first);
+            for (auto i = first; i < last; ++i, ++note)
+            {
+                auto from = time;
+                time += std::max(note->second, 0);
+                if (note->first <= 0) continue;
+
+                auto left = x(static_cast<double>(from)), right = x(static_cast<double>(time));
+                auto center = y(note->first);
+                drawList->AddRectFilled(ImVec2(left, center - noteHeight / 2),
+                                        ImVec2(std::max(right - 1, left + 1), center + noteHeight / 2),
+                                        i == playing ? IM_COL32(255, 190, 80, 255) : IM_COL32(90, 160, 255, 255));
+            }
+        } else
+        {
+            // Zoomed out: one min/max bar per pixel column.
+            for (int column = 0; column < static_cast<int>(width); ++column)
+            {
+                // Past the end, noteAt would keep returning the last note.
+                if (scroll + column * msPerPixel >= total) break;
+
+                auto from = noteAt(scroll + column * msPerPixel), to = noteAt(scroll + (column + 1) * msPerPixel) + 1;
+                auto range = pitchRange(from, std::min(to, data.size()));
+                if (range.first > range.second) continue;
+
+                auto left = origin.x + static_cast<float>(column);
+                drawList->AddRectFilled(ImVec2(left, y(range.second) - 1), ImVec2(left + 1, y(range.first) + 1),
+                                        IM_COL32(90, 160, 255, 255));
+            }
+        }
+
+        auto marker = [&](size_t index, ImU32 color)
+        {
+            if (index >= data.size()) return;
+            auto position = x(static_cast<double>(start(index)));
+            drawList->AddLine(ImVec2(position, origin.y), ImVec2(position, end.y), color, 2);
+        };
+
+        marker(cursor, IM_COL32(255, 255, 255, 160));
+        marker(playing, IM_COL32(255, 190, 80, 255));
+    }
+
+    drawList->PopClipRect();
+    return seeked;
+}
@@ -0,0 +1,553 @@
+#include "include/player.h"
+#include "include/utils.h"
+#include "include/metrics.h"
+#include "include/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <linux/kd.h>
+
+// How much of the playback thread's stack is touched up front, so it never page-faults once memory is locked.
+static constexpr size_t STACK_PREFAULT = 256 << 10;
+
+Player::Player(std::function<void()> notify)
+        : notify(std::move(notify)), commandFd(check(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))) {}
+
+Player::~Player()
+{
+    stop();
+    close(commandFd);
+}
+
+Player::ConsoleSink::ConsoleSink(const std::string &device) : fd(open(device.c_str(), O_WRONLY))
+{
+    if (fd < 0) error("Failed to open audio device: " + std::string(strerror(errno)));
+}
+
+Player::ConsoleSink::~ConsoleSink()
+{
+    if (fd >= 0) close(fd);
+}
+
+bool Player::ConsoleSink::tone(int frequency)
+{
+    if (ioctl(fd, KIOCSOUND, static_cast<int>(CLOCK_RATE / frequency)) == 0) return true;
+
+    error("Error: " + std::string(strerror(errno)));
+    return false;
+}
+
+void Player::ConsoleSink::silence() { ioctl(fd, KIOCSOUND, 0); }
+
+bool Player::play(const SnapshotStore &notes, size_t start, const std::string &device)
+{
+    auto sink = std::make_unique<ConsoleSink>(device);
+    if (!sink->ready()) return false;
+
+    play(notes, start, std::move(sink));
+    return true;
+}
+
+void Player::play(const SnapshotStore &notes, size_t start, std::unique_ptr<Sink> sink)
+{
+    stop();
+
+    active = true;
+    thread = std::thread(&Player::run, this, Source{&notes}, start, std::move(sink), realTime);
+}
+
+bool Player::play(Playlist &playlist, const std::string &device)
+{
+    auto sink = std::make_unique<ConsoleSink>(device);
+    if (!sink->ready()) return false;
+
+    play(playlist, std::move(sink));
+    return true;
+}
+
+void Player::play(Playlist &playlist, std::unique_ptr<Sink> sink)
+{
+    stop();
+
+    active = true;
+    thread = std::thread(&Player::run, this, Source{nullptr, &playlist}, 0, std::move(sink), realTime);
+}
+
+bool Player::play(const NoteView &notes, size_t start, const std::string &device)
+{
+    auto sink = std::make_unique<ConsoleSink>(device);
+    if (!sink->ready()) return false;
+
+    play(notes, start, std::move(sink));
+    return true;
+}
+
+void Player::play(const NoteView &notes, size_t start, std::unique_ptr<Sink> sink)
+{
+    stop();
+
+    active = true;
+    thread = std::thread(&Player::run, this, Source{nullptr, nullptr, nullptr, &notes}, start, std::move(sink),
+                         realTime);
+}
+
+bool Player::play(ArchiveReader &notes, size_t start, const std::string &device)
+{
+    auto sink = std::make_unique<ConsoleSink>(device);
+    if (!sink->ready()) return false;
+
+    play(notes, start, std::move(sink));
+    return true;
+}
+
+void Player::play(ArchiveReader &notes, size_t start, std::unique_ptr<Sink> sink)
+{
+    stop();
+
+    active = true;
+    thread = std::thread(&Player::run, this, Source{nullptr, nullptr, nullptr, nullptr, &notes}, start,
+                         std::move(sink), realTime);
+}
+
+bool Player::play(NoteRing &notes, const std::string &device)
+{
+    auto sink = std::make_unique<ConsoleSink>(device);
+    if (!sink->ready()) return false;
+
+    play(notes, std::move(sink));
+    return true;
+}
+
+void Player::play(NoteRing &notes, std::unique_ptr<Sink> sink)
+{
+    stop();
+
+    ring = &notes;
+    active = true;
+    thread = std::thread(&Player::run, this, Source{nullptr, nullptr, &notes}, 0, std::move(sink), realTime);
+}
+
+const SnapshotStore &Player::fixed(const NoteSequence &notes)
+{
+    stop();
+    owned = std::make_unique<SnapshotStore>();
+    owned->publish(notes);
+    return *owned;
+}
+
+bool Player::play(const NoteSequence &notes, size_t start, const std::string &device)
+{
+    return play(fixed(notes), start, device);
+}
+
+void Player::play(const NoteSequence &notes, size_t start, std::unique_ptr<Sink> sink)
+{
+    play(fixed(notes), start, std::move(sink));
+}
+
+void Player::send(Command command, size_t index)
+{
+    {
+        std::lock_guard lock(mutex);
+        commands.emplace_back(command, index);
+    }
+
+    commandPending = true;
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(commandFd, &one, sizeof(one));
+    if (ring) ring->interrupt();
+}
+
+void Player::stop()
+{
+    if (thread.joinable())
+    {
+        send(Command::STOP);
+        thread.join();
+    }
+
+    ring = nullptr;
+    std::lock_guard lock(mutex);
+    commands.clear();
+}
+
+void Player::pause() { send(Command::PAUSE); }
+
+void Player::resume() { send(Command::RESUME); }
+
+void Player::seek(size_t index) { send(Command::SEEK, index); }
+
+[[gnu::noinline]] static void prefaultStack()
+{
+    volatile unsigned char stack[STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+// First CPU listed in the kernel's isolcpus set, or -1.
+static int isolatedCPU()
+{
+    std::ifstream file("/sys/devices/system/cpu/isolated");
+    int cpu = -1;
+    return file >> cpu ? cpu : -1;
+}
+
+// mlockall is process-wide, so memory stays locked only while some real-time playback runs. Only the mappings that
+// exist when it starts are locked: MCL_FUTURE would also pin and pre-fault everything the rest of the process maps
+// later, and nothing would ever undo it.
+static std::mutex memoryLock;
+static int memoryLockHolders = 0;
+
+static bool lockMemory()
+{
+    std::lock_guard lock(memoryLock);
+    if (memoryLockHolders == 0 && mlockall(MCL_CURRENT) != 0) return false;
+
+    ++memoryLockHolders;
+    return true;
+}
+
+static void unlockMemory()
+{
+    std::lock_guard lock(memoryLock);
+    if (--memoryLockHolders == 0) munlockall();
+}
+
+// Applies as much of real-time mode to the calling thread as permissions allow. Whatever is missing is explained on
+// stderr, once per process, since it usually needs a capability or rlimit change rather than a code fix. Returns
+// whether memory was locked, which the caller undoes with unlockMemory() when playback ends.
+static bool enterRealTime(const Player::RealTime &mode)
+{
+    static std::atomic<bool> explained = false;
+    auto explain = !explained.exchange(true);
+    std::string applied;
+    auto fail = [explain](const std::string &what, int err, const std::string &fix)
+    {
+        if (explain) std::cerr << "Real-time playback: cannot " << what << " (" << strerror(err) << "); " << fix
+                               << std::endl;
+    };
+
+    sched_param param{};
+    param.sched_priority = mode.priority;
+    if (auto err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+        fail("use SCHED_FIFO priority " + std::to_string(mode.priority), err,
+             "needs root, CAP_SYS_NICE or an RLIMIT_RTPRIO of at least that (ulimit -r)");
+    else applied += " SCHED_FIFO/" + std::to_string(mode.priority);
+
+    auto locked = lockMemory();
+    if (!locked) fail("lock memory", errno, "needs root, CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK (ulimit -l)");
+    else applied += " mlockall";
+    prefaultStack();
+
+    auto cpu = mode.cpu >= 0 ? mode.cpu : isolatedCPU();
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+            fail("pin to CPU " + std::to_string(cpu), err, "check that the CPU exists and is in this process's cpuset");
+        else applied += " cpu" + std::to_string(cpu);
+    }
+    else if (explain) std::cerr << "Real-time playback: no isolated CPU (isolcpus=) and none chosen; not pinning"
+                                << std::endl;
+
+    if (prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL) != 0) fail("reduce timer slack", errno, "needs Linux 2.6.28+");
+    else applied += " timerslack=1ns";
+
+    std::clog << "Real-time playback:" << (applied.empty() ? " nothing applied" : applied) << std::endl;
+    return locked;
+}
+
+// Closes a descriptor when playback ends.
+struct Descriptor
+{
+    int fd;
+
+    ~Descriptor()
+    {
+        if (fd >= 0) close(fd);
+    }
+};
+
+static void arm(int timer, std::chrono::steady_clock::time_point deadline)
+{
+    // steady_clock is CLOCK_MONOTONIC, so its time points can be used as absolute timerfd deadlines directly; the
+    // epoch itself disarms the timer.
+    auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    itimerspec spec{};
+    spec.it_value = {static_cast<time_t>(since / 1000000000), static_cast<long>(since % 1000000000)};
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void Player::run(Source source, size_t start, std::unique_ptr<Sink> sink, RealTime mode)
+{
+    TRACE_THREAD("player");
+    auto locked = mode.enabled && enterRealTime(mode);
+
+    Descriptor timer{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)};
+    Descriptor poll{epoll_create1(EPOLL_CLOEXEC)};
+    Descriptor signals{sigisemptyset(&stopSignals) ? -1 : signalfd(-1, &stopSignals, SFD_CLOEXEC | SFD_NONBLOCK)};
+
+    // An empty ring puts the player to sleep on its futex, where a signalfd cannot reach it, so with a ring a helper
+    // thread watches for the signals instead and turns one into a stop command, which does interrupt the ring.
+    Descriptor quit{source.ring && signals.fd >= 0 ? eventfd(0, EFD_CLOEXEC) : -1};
+    std::thread watcher;
+    if (quit.fd >= 0)
+        watcher = std::thread([this, &signals, &quit]
+                              {
+                                  pollfd fds[2] = {{signals.fd, POLLIN, 0}, {quit.fd, POLLIN, 0}};
+                                  while (::poll(fds, 2, -1) < 0 && errno == EINTR);
+
+                                  signalfd_siginfo info;
+                                  if (fds[0].revents & POLLIN && read(signals.fd, &info, sizeof(info)) > 0)
+                                      send(Command::STOP);
+                              });
+
+    auto playlist = source.playlist;
+    for (auto fd: {timer.fd, commandFd, quit.fd >= 0 ? -1 : signals.fd, playlist ? playlist->readyFd() : -1})
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (fd >= 0) epoll_ctl(poll.fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    // Note boundaries are scheduled against absolute deadlines so oversleeping does not accumulate; how late each
+    // boundary actually happens is recorded as scheduling jitter.
+    static auto &jitter = Metrics::histogram("playback.jitter_us");
+    jitter.reset();
+    static auto &gaps = Metrics::gauge("playlist.gaps");
+    static auto &overruns = Metrics::gauge("ring.overruns"), &underruns = Metrics::gauge("ring.underruns");
+
+    auto index = start;
+    auto deadline = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration remaining{};
+    bool sounding = false, restart = false, waiting = false, streaming = false;
+    std::pair<int, int> note;
+    int frequency = 0;
+    std::shared_ptr<const NoteSequence> program;
+
+    auto silence = [&]
+    {
+        if (sounding) sink->silence();
+        sounding = false;
+    };
+
+    // Reads note `index` into `note`. A playlist moves on to its next item at the end of the current one, and sets
+    // `waiting` when that item is still loading; a ring sets it while it is empty.
+    auto fetch = [&]
+    {
+        if (source.ring)
+        {
+            NoteEvent event{};
+            waiting = !source.ring->pop(event);
+            if (waiting && source.ring->finished()) return false;
+
+            // Running dry right after a note is an underrun; waiting for the first event, or after one, is not.
+            if (waiting && streaming) source.ring->underrun();
+            streaming = !waiting;
+            overruns.set(static_cast<int64_t>(source.ring->overruns()));
+            underruns.set(static_cast<int64_t>(source.ring->underruns()));
+
+            note = {std::max(0, event.frequency), std::max(0, event.duration)};
+            return true;
+        }
+
+        if (source.notes)
+        {
+            SnapshotStore::Guard snapshot(*source.notes);
+            if (index >= snapshot->notes.size()) return false;
+            note = snapshot->notes[index];
+            return true;
+        }
+
+        if (source.view)
+        {
+            if (index >= source.view->size()) return false;
+            note = (*source.view)[index];
+            return true;
+        }
+
+        if (source.archive)
+        {
+            // Reading on from the previous note stays within the decoded block; only a seek can move elsewhere.
+            if (source.archive->position() != index && !source.archive->seek(index)) return false;
+            return source.archive->next(note);
+        }
+
+        while (!program || index >= program->size())
+        {
+            auto next = playlist->take(program);
+            if (next == Playlist::Next::END) return false;
+
+            waiting = next == Playlist::Next::PENDING;
+            if (waiting) return true;
+            index = 0;
+        }
+
+        note = (*program)[index];
+        return true;
+    };
+
+    // Starts note `index` at `deadline`, with the tempo and transposition current at that moment. Returns false at
+    // the end of the sequence or when the sink fails.
+    auto begin = [&]
+    {
+        if (!fetch()) return false;
+        if (waiting) return true;
+
+        frequency = note.first;
+        if (auto semitones = shift.load(std::memory_order_relaxed); semitones != 0 && frequency > 0)
+            frequency = std::max(1, static_cast<int>(std::lround(frequency * std::exp2(semitones / 12.0))));
+
+        TRACE_INSTANT("note");
+        current = index;
+        currentFreq = frequency;
+        if (notify) notify();
+
+        if (frequency > 0 && !sink->tone(frequency)) return false;
+        sounding = frequency > 0;
+
+        auto tempo = tempoFactor.load(std::memory_order_relaxed);
+        auto length = std::chrono::duration<double, std::milli>(note.second / tempo);
+        deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(length);
+        arm(timer.fd, deadline);
+        return true;
+    };
+
+    auto running = begin();
+    while (running)
+    {
+        // An empty ring wakes the player through its futex, which epoll cannot watch, so the player sleeps there and
+        // then only checks for commands; stop signals reach it as commands through the watcher thread.
+        auto onRing = source.ring && waiting && !isPaused;
+        if (onRing) source.ring->wait(&commandPending);
+
+        epoll_event events[4];
+        auto count = epoll_wait(poll.fd, events, 4, onRing ? 0 : -1);
+        if (count < 0 && errno != EINTR)
+        {
+            error("Playback loop failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        for (int e = 0; e < count && running; ++e)
+        {
+            uint64_t value;
+            auto fd = events[e].data.fd;
+
+            if (fd == timer.fd)
+            {
+                if (read(timer.fd, &value, sizeof(value)) < 0 || isPaused) continue;
+
+                silence();
+                auto late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                  deadline);
+                jitter.record(std::max<int64_t>(late.count(), 0));
+
+                ++index;
+                running = begin();
+            }
+            else if (fd == signals.fd)
+            {
+                signalfd_siginfo info;
+                if (read(signals.fd, &info, sizeof(info)) > 0) running = false;
+            }
+            else if (playlist && fd == playlist->readyFd())
+            {
+                if (read(fd, &value, sizeof(value)) < 0 || !waiting || isPaused) continue;
+
+                // Loading fell behind playback: the next item starts now rather than when the last one ended.
+                if (program) gaps.add(1);
+                deadline = std::chrono::steady_clock::now();
+                running = begin();
+            }
+            else if (fd == commandFd)
+            {
+                [[maybe_unused]] auto drained = read(commandFd, &value, sizeof(value));
+                std::vector<std::pair<Command, size_t>> pending;
+                {
+                    std::lock_guard lock(mutex);
+                    commandPending = false;
+                    pending.swap(commands);
+                }
+
+                for (auto [command, target]: pending)
+                {
+                    auto now = std::chrono::steady_clock::now();
+                    if (command == Command::STOP) running = false;
+                    else if (command == Command::PAUSE && !isPaused)
+                    {
+                        silence();
+                        remaining = deadline - now;
+                        arm(timer.fd, {});
+                        isPaused = true;
+                    }
+                    else if (command == Command::RESUME && isPaused)
+                    {
+                        isPaused = false;
+                        deadline = now;
+                        if (restart || waiting) running = begin();
+                        else
+                        {
+                            // Finish the interrupted note for as long as it had left.
+                            deadline += remaining;
+                            sounding = frequency > 0;
+                            if (sounding && !sink->tone(frequency)) running = false;
+                            arm(timer.fd, deadline);
+                        }
+                        restart = false;
+                    }
+                    else if (command == Command::SEEK && !source.ring)
+                    {
+                        silence();
+                        index = target;
+                        deadline = now;
+                        restart = isPaused;
+                        if (!isPaused) running = begin();
+                    }
+
+                    if (!running) break;
+                }
+
+                if (notify) notify();
+            }
+        }
+
+        // An event pushed while the player was waiting on the ring starts as soon as it is seen.
+        if (running && source.ring && waiting && !isPaused)
+        {
+            deadline = std::chrono::steady_clock::now();
+            running = begin();
+        }
+    }
+
+    if (watcher.joinable())
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(quit.fd, &one, sizeof(one));
+        watcher.join();
+    }
+
+    silence();
+    if (locked) unlockMemory();
+    current = SIZE_MAX;
+    currentFreq = 0;
+    isPaused = false;
+    active = false;
+    if (notify) notify();
+}
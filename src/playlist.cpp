@@ -0,0 +1,130 @@
+#include "include/playlist.h"
+#include "include/audio.h"
+#include "include/metrics.h"
+#include "include/trace.h"
+#include "include/utils.h"
+
+#include <vector>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+Playlist::Playlist(size_t budget) : budget(budget), eventFd(check(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)))
+{
+    loader = std::thread(&Playlist::load, this);
+}
+
+Playlist::~Playlist()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+
+    changed.notify_all();
+    loader.join();
+    close(eventFd);
+}
+
+void Playlist::add(const std::string &path)
+{
+    {
+        std::lock_guard lock(mutex);
+        items.push_back({path, {}});
+    }
+
+    changed.notify_all();
+}
+
+Playlist::Next Playlist::take(std::shared_ptr<const NoteSequence> &program)
+{
+    static auto &bufferedGauge = Metrics::gauge("memory.playlist_bytes");
+
+    std::unique_lock lock(mutex);
+    while (next < items.size() && items[next].failed) ++next;
+    if (next == items.size()) return Next::END;
+
+    auto &item = items[next];
+    if (!item.loaded) return Next::PENDING;
+
+    std::swap(program, item.notes);
+    bufferedBytes -= item.bytes;
+    bufferedGauge.set(static_cast<int64_t>(bufferedBytes));
+    ++next;
+
+    lock.unlock();
+    changed.notify_all();
+    return Next::READY;
+}
+
+size_t Playlist::size() const
+{
+    std::lock_guard lock(mutex);
+    return items.size();
+}
+
+size_t Playlist::position() const
+{
+    std::lock_guard lock(mutex);
+    return next - 1;
+}
+
+size_t Playlist::buffered() const
+{
+    std::lock_guard lock(mutex);
+    return bufferedBytes;
+}
+
+void Playlist::load()
+{
+    TRACE_THREAD("playlist");
+    static auto &bufferedGauge = Metrics::gauge("memory.playlist_bytes");
+
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        changed.wait(lock, [this]
+        {
+            return stopping || released < next ||
+                   (loading < items.size() && (bufferedBytes < budget || loading <= next));
+        });
+        if (stopping) return;
+
+        // Items the player has moved past hold whatever it swapped out of them; free those here, off its thread.
+        if (released < next)
+        {
+            std::vector<std::shared_ptr<const NoteSequence>> spent;
+            for (; released < next; ++released) spent.push_back(std::move(items[released].notes));
+
+            lock.unlock();
+            spent.clear();
+            lock.lock();
+            continue;
+        }
+
+        auto path = items[loading].path;
+        lock.unlock();
+
+        std::shared_ptr<const NoteSequence> notes;
+        {
+            TRACE_SCOPE("playlist.load");
+            std::vector<std::pair<int, int>> data;
+            if (AudioManager::importFile(data, path.c_str())) notes = std::make_shared<const NoteSequence>(data);
+        }
+
+        lock.lock();
+        auto &item = items[loading++];
+        item.failed = !notes;
+        item.loaded = !item.failed;
+        if (notes)
+        {
+            item.bytes = notes->bytes();
+            item.notes = std::move(notes);
+            bufferedBytes += item.bytes;
+            bufferedGauge.set(static_cast<int64_t>(bufferedBytes));
+        }
+
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(eventFd, &one, sizeof(one));
+    }
+}
@@ -0,0 +1,128 @@
+#include "include/plugins.h"
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+#include "include/cache.h"
+#include "include/utils.h"
+
+std::mutex PluginRegistry::mutex;
+
+std::vector<PluginRegistry::Entry> &PluginRegistry::entries()
+{
+    static std::vector<Entry> entries = {
+        {"mp3", "libsoundtest_mp3.so", {{0, {'I', 'D', '3'}, {}}, {0, {0xFF, 0xE0}, {0xFF, 0xE0}}}},
+        {"soundcloud", "libsoundtest_soundcloud.so", {}},
+    };
+
+    return entries;
+}
+
+void PluginRegistry::add(const std::string &name, const std::string &module, std::vector<Magic> magic)
+{
+    std::lock_guard lock(mutex);
+    auto &list = entries();
+    auto entry = std::find_if(list.begin(), list.end(), [&](const Entry &e) { return e.name == name; });
+    if (entry == list.end()) list.push_back({name, module, std::move(magic)});
+    else *entry = {name, module, std::move(magic)};
+}
+
+const SoundTestPlugin* PluginRegistry::get(const std::string &name)
+{
+    std::lock_guard lock(mutex);
+    for (auto &entry: entries())
+    {
+        if (entry.name != name) continue;
+        if (!entry.attempted)
+        {
+            entry.attempted = true;
+            entry.plugin = load(entry);
+        }
+
+        return entry.plugin;
+    }
+
+    error("No importer plugin named " + name + " is registered.");
+    return nullptr;
+}
+
+std::string PluginRegistry::identify(const unsigned char* header, size_t size)
+{
+    std::lock_guard lock(mutex);
+    for (auto &entry: entries())
+    {
+        for (auto &magic: entry.magic)
+        {
+            if (magic.offset + magic.bytes.size() > size) continue;
+
+            bool match = true;
+            for (size_t i = 0; i < magic.bytes.size() && match; ++i)
+            {
+                auto mask = i < magic.mask.size() ? magic.mask[i] : 0xFF;
+                match = (header[magic.offset + i] & mask) == magic.bytes[i];
+            }
+
+            if (match) return entry.name;
+        }
+    }
+
+    return {};
+}
+
+// Modules are searched for in $SOUNDTEST_PLUGIN_PATH, then next to the executable (in plugins/ and beside it), and
+// finally by the dynamic linker's own search path.
+static std::vector<std::string> candidates(const std::string &module)
+{
+    std::vector<std::string> paths;
+    if (auto path = getenv("SOUNDTEST_PLUGIN_PATH"))
+    {
+        std::stringstream list(path);
+        for (std::string directory; std::getline(list, directory, ':');)
+            if (!directory.empty()) paths.push_back((std::filesystem::path(directory) / module).string());
+    }
+
+    std::error_code ec;
+    auto executable = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec)
+    {
+        paths.push_back((executable.parent_path() / "plugins" / module).string());
+        paths.push_back((executable.parent_path() / module).string());
+    }
+
+    paths.push_back(module);
+    return paths;
+}
+
+const SoundTestPlugin* PluginRegistry::load(const Entry &entry)
+{
+    // Plugins log their own errors, so the host only passes them on to the handler.
+    static std::string cacheDirectory = ImportCache::root().string();
+    static const SoundTestHost host = {
+        SOUNDTEST_PLUGIN_ABI,
+        [](const char* message) { if (auto handler = errorHandler.load()) handler(message); },
+        cacheDirectory.c_str()
+    };
+
+    std::string reason;
+    for (auto &path: candidates(entry.module))
+    {
+        auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle)
+        {
+            if (reason.empty() || std::filesystem::exists(path)) reason = dlerror();
+            continue;
+        }
+
+        auto symbol = reinterpret_cast<SoundTestPluginEntry>(dlsym(handle, SOUNDTEST_PLUGIN_ENTRY));
+        auto plugin = symbol ? symbol(&host) : nullptr;
+        if (plugin && plugin->abi == SOUNDTEST_PLUGIN_ABI) return plugin;
+
+        reason = path + (plugin ? " was built for a different plugin ABI" : " is not a SoundTest plugin");
+        dlclose(handle);
+    }
+
+    error("The " + entry.name + " importer is unavailable: " + reason);
+    return nullptr;
+}
@@ -0,0 +1,63 @@
+#include "include/pool.h"
+#include "include/utils.h"
+#include "include/trace.h"
+
+WorkerPool::WorkerPool(unsigned int workers, size_t queueLimit) : queueLimit(queueLimit ? queueLimit : workers)
+{
+    if (workers == 0) workers = 1;
+    for (unsigned int i = 0; i < workers; ++i) threads.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+
+    taskReady.notify_all();
+    for (auto &thread: threads) thread.join();
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    std::unique_lock lock(mutex);
+    taskTaken.wait(lock, [this] { return tasks.size() < queueLimit; });
+
+    tasks.push_back(std::move(task));
+    taskReady.notify_one();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void WorkerPool::work()
+{
+    TRACE_THREAD("worker");
+
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            ++running;
+        }
+
+        taskTaken.notify_one();
+        {
+            TRACE_SCOPE("task");
+            task();
+        }
+
+        std::lock_guard lock(mutex);
+        if (--running == 0 && tasks.empty()) idle.notify_all();
+    }
+}
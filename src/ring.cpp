@@ -0,0 +1,184 @@
+#include "include/ring.h"
+#include "include/utils.h"
+
+#include <bit>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Shared (not FUTEX_PRIVATE) futex operations, so producer and consumer may live in different processes.
+static bool futexWait(std::atomic<uint32_t> &word, uint32_t expected, const timespec* timeout)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0) == 0 ||
+           errno != ETIMEDOUT;
+}
+
+static void futexWake(std::atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+NoteRing::~NoteRing() { close(); }
+
+bool NoteRing::open(const std::string &name, uint32_t capacity)
+{
+    close();
+
+    capacity = std::bit_ceil(std::max<uint32_t>(capacity, 2));
+    auto size = sizeof(NoteRingHeader) + size_t{capacity} * sizeof(NoteEvent);
+
+    auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    auto created = fd >= 0;
+    if (!created && errno == EEXIST) fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0 || (created && ftruncate(fd, static_cast<off_t>(size)) != 0))
+    {
+        error("Failed to open note ring " + name + ": " + std::string(strerror(errno)));
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+
+    // A ring someone else is creating may not have its final size yet.
+    struct stat info{};
+    for (int attempt = 0; !created && attempt < 100; ++attempt)
+    {
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(NoteRingHeader)) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!created) size = static_cast<size_t>(info.st_size);
+
+    auto mapped = size >= sizeof(NoteRingHeader) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                                 : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        error("Failed to map note ring " + name + ".");
+        return false;
+    }
+
+    header = static_cast<NoteRingHeader*>(mapped);
+    events = reinterpret_cast<NoteEvent*>(static_cast<char*>(mapped) + sizeof(NoteRingHeader));
+    mappedSize = size;
+
+    if (created)
+    {
+        header->version = NoteRingHeader::VERSION;
+        header->capacity = capacity;
+        header->eventSize = sizeof(NoteEvent);
+        // The magic goes in last, so a side that sees it also sees the fields above.
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(header->magic, NoteRingHeader::MAGIC, sizeof(header->magic));
+    }
+    else
+    {
+        for (int attempt = 0; attempt < 100 && memcmp(header->magic, NoteRingHeader::MAGIC, 4) != 0; ++attempt)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        auto valid = memcmp(header->magic, NoteRingHeader::MAGIC, 4) == 0 &&
+                     header->version == NoteRingHeader::VERSION && header->eventSize == sizeof(NoteEvent) &&
+                     std::has_single_bit(header->capacity) &&
+                     size >= sizeof(NoteRingHeader) + size_t{header->capacity} * sizeof(NoteEvent);
+        if (!valid)
+        {
+            error("Note ring " + name + " is not a version " + std::to_string(NoteRingHeader::VERSION) + " ring.");
+            close();
+            return false;
+        }
+    }
+
+    mask = header->capacity - 1;
+    return true;
+}
+
+void NoteRing::close()
+{
+    if (header) munmap(header, mappedSize);
+    header = nullptr;
+    events = nullptr;
+    mappedSize = 0;
+}
+
+bool NoteRing::unlink(const std::string &name) { return shm_unlink(name.c_str()) == 0; }
+
+bool NoteRing::push(const NoteEvent &event) { return push(&event, 1) == 1; }
+
+size_t NoteRing::push(const NoteEvent* source, size_t count)
+{
+    auto head = header->head.load(std::memory_order_relaxed);
+    auto space = header->capacity - (head - header->tail.load(std::memory_order_acquire));
+    auto pushed = std::min<size_t>(count, space);
+    if (pushed < count) header->overruns.fetch_add(count - pushed, std::memory_order_relaxed);
+    if (pushed == 0) return 0;
+
+    // At most two copies, either side of the wrap.
+    auto first = std::min<size_t>(pushed, mask + 1 - (head & mask));
+    memcpy(events + (head & mask), source, first * sizeof(NoteEvent));
+    memcpy(events, source + first, (pushed - first) * sizeof(NoteEvent));
+
+    // Sequentially consistent so that either the consumer sees the new head before sleeping, or this sees it asleep.
+    header->head.store(head + pushed, std::memory_order_seq_cst);
+    if (header->sleeping.load(std::memory_order_seq_cst)) interrupt();
+    return pushed;
+}
+
+void NoteRing::finish()
+{
+    header->closed.store(1, std::memory_order_seq_cst);
+    interrupt();
+}
+
+bool NoteRing::pop(NoteEvent &event)
+{
+    auto tail = header->tail.load(std::memory_order_relaxed);
+    if (tail == header->head.load(std::memory_order_acquire)) return false;
+
+    event = events[tail & mask];
+    header->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+void NoteRing::wait(const std::atomic<bool>* cancel, int timeout)
+{
+    header->sleeping.store(1, std::memory_order_seq_cst);
+    if (header->head.load(std::memory_order_seq_cst) != header->tail.load(std::memory_order_relaxed) ||
+        header->closed.load(std::memory_order_seq_cst) || (cancel && cancel->load(std::memory_order_seq_cst)))
+    {
+        header->sleeping.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    timespec limit{timeout / 1000, timeout % 1000 * 1000000L};
+    while (header->sleeping.load(std::memory_order_acquire) == 1)
+        if (!futexWait(header->sleeping, 1, timeout < 0 ? nullptr : &limit))
+        {
+            header->sleeping.store(0, std::memory_order_relaxed);
+            return;
+        }
+}
+
+void NoteRing::interrupt()
+{
+    if (header->sleeping.exchange(0, std::memory_order_seq_cst)) futexWake(header->sleeping);
+}
+
+void NoteRing::underrun() { header->underruns.fetch_add(1, std::memory_order_relaxed); }
+
+bool NoteRing::finished() const
+{
+    return header->closed.load(std::memory_order_acquire) &&
+           header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_relaxed);
+}
+
+size_t NoteRing::size() const
+{
+    if (!header) return 0;
+    return header->head.load(std::memory_order_acquire) - header->tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,194 @@
+#include "include/sequence.h"
+
+#include <algorithm>
+
+std::pair<size_t, size_t> NoteSequence::locate(size_t index) const
+{
+    if (chunks.empty()) return {0, 0};
+
+    auto chunk = static_cast<size_t>(std::upper_bound(starts.begin(), starts.end() - 1, index) - starts.begin()) - 1;
+    return {chunk, index - starts[chunk]};
+}
+
+NoteSequence::Note NoteSequence::operator[](size_t index) const
+{
+    auto [chunk, offset] = locate(index);
+    return (*chunks[chunk])[offset];
+}
+
+NoteSequence::Iterator NoteSequence::at(size_t index) const
+{
+    if (index >= size()) return end();
+
+    auto [chunk, offset] = locate(index);
+    return {this, chunk, offset};
+}
+
+NoteSequence::Chunk &NoteSequence::writable(size_t chunk)
+{
+    if (chunks[chunk].use_count() > 1) chunks[chunk] = std::make_shared<Chunk>(*chunks[chunk]);
+    return *chunks[chunk];
+}
+
+void NoteSequence::reindex(size_t from)
+{
+    starts.resize(chunks.size() + 1);
+    if (from == 0) starts[0] = 0;
+    for (auto i = from; i < chunks.size(); ++i) starts[i + 1] = starts[i] + chunks[i]->size();
+}
+
+size_t NoteSequence::split(size_t chunk, size_t offset)
+{
+    if (offset == 0) return chunk;
+    if (offset == chunks[chunk]->size()) return chunk + 1;
+
+    auto &source = *chunks[chunk];
+    auto tail = std::make_shared<Chunk>(source.begin() + static_cast<long>(offset), source.end());
+    if (chunks[chunk].use_count() > 1) chunks[chunk] = std::make_shared<Chunk>(source.begin(), source.begin() +
+                                                                                              static_cast<long>(offset));
+    else source.resize(offset);
+
+    chunks.insert(chunks.begin() + static_cast<long>(chunk) + 1, std::move(tail));
+    reindex(chunk);
+    return chunk + 1;
+}
+
+// Keeps chunks from fragmenting: an empty chunk is dropped and one under half of CHUNK is folded into a neighbour
+// when the result still fits.
+void NoteSequence::merge(size_t chunk)
+{
+    if (chunk >= chunks.size()) return;
+
+    auto size = chunks[chunk]->size();
+    if (size == 0) chunks.erase(chunks.begin() + static_cast<long>(chunk));
+    else if (size >= CHUNK / 2) return;
+    else if (chunk + 1 < chunks.size() && size + chunks[chunk + 1]->size() <= 2 * CHUNK)
+    {
+        auto next = chunks[chunk + 1];
+        auto &target = writable(chunk);
+        target.insert(target.end(), next->begin(), next->end());
+        chunks.erase(chunks.begin() + static_cast<long>(chunk) + 1);
+    }
+    else if (chunk > 0 && size + chunks[chunk - 1]->size() <= 2 * CHUNK)
+    {
+        auto current = chunks[chunk];
+        auto &target = writable(chunk - 1);
+        target.insert(target.end(), current->begin(), current->end());
+        chunks.erase(chunks.begin() + static_cast<long>(chunk));
+    }
+    else return;
+
+    reindex(chunk > 0 ? chunk - 1 : 0);
+}
+
+void NoteSequence::set(size_t index, Note note)
+{
+    auto [chunk, offset] = locate(index);
+    writable(chunk)[offset] = note;
+}
+
+void NoteSequence::insert(size_t index, const Note* notes, size_t count)
+{
+    if (count == 0) return;
+    if (chunks.empty())
+    {
+        chunks.push_back(std::make_shared<Chunk>());
+        starts = {0, 0};
+    }
+
+    auto [chunk, offset] = locate(index);
+    if (chunks[chunk]->size() + count <= 2 * CHUNK)
+    {
+        auto &target = writable(chunk);
+        target.insert(target.begin() + static_cast<long>(offset), notes, notes + count);
+        reindex(chunk);
+        return;
+    }
+
+    // Larger inserts cut the chunk at the insertion point and lay the new notes out as whole chunks in between.
+    auto position = split(chunk, offset);
+    std::vector<std::shared_ptr<Chunk>> added;
+    for (size_t i = 0; i < count; i += CHUNK)
+        added.push_back(std::make_shared<Chunk>(notes + i, notes + std::min(count, i + CHUNK)));
+
+    chunks.insert(chunks.begin() + static_cast<long>(position), added.begin(), added.end());
+    reindex(position > 0 ? position - 1 : 0);
+    merge(position + added.size());
+    merge(position > 0 ? position - 1 : 0);
+}
+
+void NoteSequence::erase(size_t first, size_t last)
+{
+    last = std::min(last, size());
+    if (first >= last) return;
+
+    auto [chunk, offset] = locate(first);
+    if (offset + (last - first) <= chunks[chunk]->size())
+    {
+        auto &target = writable(chunk);
+        target.erase(target.begin() + static_cast<long>(offset), target.begin() + static_cast<long>(offset + last -
+                                                                                                    first));
+        reindex(chunk);
+        merge(chunk);
+        return;
+    }
+
+    auto from = split(chunk, offset);
+    auto [lastChunk, lastOffset] = locate(last);
+    auto to = last == size() ? chunks.size() : split(lastChunk, lastOffset);
+
+    chunks.erase(chunks.begin() + static_cast<long>(from), chunks.begin() + static_cast<long>(to));
+    reindex(from > 0 ? from - 1 : 0);
+    merge(from);
+    merge(from > 0 ? from - 1 : 0);
+}
+
+void NoteSequence::rotate(size_t first, size_t middle, size_t last)
+{
+    if (first >= middle || middle >= last) return;
+
+    auto left = middle - first, right = last - middle;
+    if (left <= right)
+    {
+        auto moved = copy(first, middle);
+        erase(first, middle);
+        insert(last - left, moved.data(), moved.size());
+    }
+    else
+    {
+        auto moved = copy(middle, last);
+        erase(middle, last);
+        insert(first, moved.data(), moved.size());
+    }
+}
+
+void NoteSequence::clear()
+{
+    chunks.clear();
+    starts.clear();
+}
+
+std::vector<NoteSequence::Note> NoteSequence::copy(size_t first, size_t last) const
+{
+    std::vector<Note> notes;
+    last = std::min(last, size());
+    if (first >= last) return notes;
+
+    notes.reserve(last - first);
+    for (auto [chunk, offset] = locate(first); notes.size() < last - first; ++chunk, offset = 0)
+    {
+        auto &source = *chunks[chunk];
+        auto count = std::min(source.size() - offset, last - first - notes.size());
+        notes.insert(notes.end(), source.begin() + static_cast<long>(offset),
+                     source.begin() + static_cast<long>(offset + count));
+    }
+
+    return notes;
+}
+
+size_t NoteSequence::bytes() const
+{
+    size_t total = chunks.capacity() * sizeof(chunks[0]) + starts.capacity() * sizeof(size_t);
+    for (auto &chunk: chunks) total += sizeof(Chunk) + chunk->capacity() * sizeof(Note);
+    return total;
+}
@@ -0,0 +1,61 @@
+#include "include/snapshot.h"
+
+#include <thread>
+
+SnapshotStore::Guard::Guard(const SnapshotStore &store)
+{
+    // Claim a free slot, then record the epoch before loading the pointer: a writer that retires a version after this
+    // load tags it with this epoch or a later one, so it will see the slot and keep the version alive.
+    for (size_t i = 0;; i = (i + 1) % READERS)
+    {
+        uint64_t free = 0;
+        if (store.slots[i].epoch.compare_exchange_strong(free, 1))
+        {
+            slot = &store.slots[i].epoch;
+            break;
+        }
+
+        if (i == READERS - 1) std::this_thread::yield();
+    }
+
+    slot->store(store.epoch.load());
+    snapshot = store.current.load();
+}
+
+SnapshotStore::Guard::~Guard() { slot->store(0); }
+
+SnapshotStore::SnapshotStore() : current(new Snapshot{{}, 0}) {}
+
+SnapshotStore::~SnapshotStore()
+{
+    delete current.load();
+    for (auto &[snapshot, epoch]: retiredVersions) delete snapshot;
+}
+
+void SnapshotStore::publish(const NoteSequence &notes)
+{
+    auto previous = current.exchange(new Snapshot{notes, current.load()->version + 1});
+    retiredVersions.emplace_back(previous, epoch.fetch_add(1));
+    reclaim();
+}
+
+// A version retired in epoch E may still be in use by a reader that entered in epoch E or earlier; readers that
+// entered later loaded the pointer after it was replaced.
+void SnapshotStore::reclaim()
+{
+    auto oldest = UINT64_MAX;
+    for (auto &slot: slots)
+    {
+        auto entered = slot.epoch.load();
+        if (entered == 1) return;
+        if (entered != 0) oldest = std::min(oldest, entered);
+    }
+
+    std::erase_if(retiredVersions, [oldest](auto &retired)
+    {
+        if (retired.second >= oldest) return false;
+
+        delete retired.first;
+        return true;
+    });
+}
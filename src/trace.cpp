@@ -0,0 +1,179 @@
+#include "include/trace.h"
+#include "include/utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef SOUNDTEST_TRACING
+std::atomic<bool> Trace::enabled = getenv("SOUNDTEST_TRACE") != nullptr;
+#else
+std::atomic<bool> Trace::enabled = false;
+#endif
+
+// Each thread only ever writes its own buffer, so recording needs no synchronization beyond publishing the head.
+// Buffers outlive their threads so short-lived workers still show up in the export; only the most recent retired
+// ones are kept.
+struct TraceBuffer
+{
+    static constexpr size_t CAPACITY = 1 << 14, RETIRED = 16;
+
+    std::array<Trace::Event, CAPACITY> events{};
+    std::atomic<uint64_t> head = 0;
+    std::atomic<const char*> name = nullptr;
+    std::atomic<bool> retired = false;
+    long tid = syscall(SYS_gettid);
+};
+
+static std::mutex buffersMutex;
+static std::deque<std::shared_ptr<TraceBuffer>> buffers;
+
+// Timestamps are raw ticks (the TSC on x86); they are converted to microseconds against this origin at export time.
+static const auto originTicks = Trace::now();
+static const auto originTime = std::chrono::steady_clock::now();
+
+// Set by nameThread even while tracing is off, so a thread that starts recording later is still named.
+static thread_local const char* threadName = nullptr;
+// A plain pointer avoids the thread_local initialization guard on every event; null until the thread records.
+static thread_local TraceBuffer* localBuffer = nullptr;
+
+// Creates this thread's buffer on its first event, so threads that never record never allocate one.
+static TraceBuffer &createBuffer()
+{
+    thread_local struct Holder
+    {
+        std::shared_ptr<TraceBuffer> buffer = std::make_shared<TraceBuffer>();
+
+        Holder()
+        {
+            std::lock_guard lock(buffersMutex);
+            auto retired = std::count_if(buffers.begin(), buffers.end(), [](auto &b) { return b->retired.load(); });
+            for (auto it = buffers.begin(); it != buffers.end() && retired > static_cast<long>(TraceBuffer::RETIRED);)
+                if ((*it)->retired)
+                {
+                    it = buffers.erase(it);
+                    --retired;
+                } else ++it;
+
+            buffer->name = threadName;
+            buffers.push_back(buffer);
+        }
+
+        ~Holder() { buffer->retired = true; }
+    } holder;
+
+    localBuffer = holder.buffer.get();
+    return *localBuffer;
+}
+
+void Trace::record(const char* name, uint64_t start, uint64_t duration)
+{
+    auto &buffer = localBuffer ? *localBuffer : createBuffer();
+    auto head = buffer.head.load(std::memory_order_relaxed);
+
+    buffer.events[head % TraceBuffer::CAPACITY] = {name, start, duration};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::nameThread(const char* name)
+{
+    threadName = name;
+    if (localBuffer) localBuffer->name = name;
+}
+
+static void writeString(std::ostream &out, const char* text)
+{
+    out << '"';
+    for (; *text; ++text)
+    {
+        if (*text == '"' || *text == '\\') out << '\\';
+        out << *text;
+    }
+
+    out << '"';
+}
+
+void Trace::flush()
+{
+    auto path = getenv("SOUNDTEST_TRACE");
+    if (path && *path) write(path);
+}
+
+bool Trace::write(const std::string &path)
+{
+#ifndef SOUNDTEST_TRACING
+    error("Tracing is not compiled in; rebuild with -DSOUNDTEST_TRACING=ON.");
+    return false;
+#endif
+
+    std::vector<std::shared_ptr<TraceBuffer>> snapshot;
+    {
+        std::lock_guard lock(buffersMutex);
+        snapshot.assign(buffers.begin(), buffers.end());
+    }
+
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - originTime).count();
+    auto ticksPerMicrosecond = elapsed > 0 ? static_cast<double>(now() - originTicks) / elapsed : 1.0;
+    auto microseconds = [&](uint64_t ticks) { return static_cast<double>(ticks) / ticksPerMicrosecond; };
+
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        error("Failed to open file: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    auto pid = getpid();
+    size_t written = 0;
+    file << std::fixed;
+    file.precision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (auto &buffer: snapshot)
+    {
+        if (auto name = buffer->name.load())
+        {
+            file << (written++ ? ",\n" : "\n") << R"({"ph":"M","name":"thread_name","pid":)" << pid
+                 << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+            writeString(file, name);
+            file << "}}";
+        }
+
+        // Copy the live part of the ring, then drop whatever the owning thread may have overwritten meanwhile.
+        auto head = buffer->head.load(std::memory_order_acquire);
+        auto first = head > TraceBuffer::CAPACITY ? head - TraceBuffer::CAPACITY : 0;
+        std::vector<Event> events;
+        for (auto i = first; i < head; ++i) events.push_back(buffer->events[i % TraceBuffer::CAPACITY]);
+
+        auto overwritten = buffer->head.load(std::memory_order_acquire);
+        auto skip = overwritten > TraceBuffer::CAPACITY + first ? overwritten - TraceBuffer::CAPACITY - first : 0;
+
+        for (auto i = std::min(skip, events.size()); i < events.size(); ++i)
+        {
+            auto &event = events[i];
+            if (event.start < originTicks) continue;
+
+            file << (written++ ? ",\n" : "\n") << "{\"name\":";
+            writeString(file, event.name);
+            file << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid << ",\"ts\":"
+                 << microseconds(event.start - originTicks);
+
+            if (event.duration == INSTANT) file << R"(,"ph":"i","s":"t"})";
+            else file << R"(,"ph":"X","dur":)" << microseconds(event.duration) << '}';
+        }
+    }
+
+    file << "\n]}\n";
+    if (!file.good()) return false;
+
+    std::clog << "Wrote " << written << " trace events to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "include/waveform.h"
+
+#include <algorithm>
+#include <fstream>
+
+static thread_local Waveform* capturing = nullptr;
+
+Waveform::Capture::Capture(Waveform &waveform, double startMs)
+{
+    waveform.reset(0, startMs);
+    capturing = &waveform;
+}
+
+Waveform::Capture::~Capture() { capturing = nullptr; }
+
+Waveform* Waveform::current() { return capturing; }
+
+void Waveform::reset(long sampleRate, double startMs)
+{
+    levels.assign(1, {});
+    rate = sampleRate;
+    start = startMs;
+    min = INT16_MAX;
+    max = INT16_MIN;
+    count = 0;
+}
+
+void Waveform::begin(long sampleRate)
+{
+    if (rate == 0) rate = sampleRate;
+}
+
+void Waveform::flush()
+{
+    if (levels.empty()) levels.emplace_back();
+    levels.front().push_back({static_cast<int16_t>(std::clamp(min, INT16_MIN, INT16_MAX)),
+                              static_cast<int16_t>(std::clamp(max, INT16_MIN, INT16_MAX))});
+
+    min = INT16_MAX;
+    max = INT16_MIN;
+    count = 0;
+}
+
+void Waveform::finish()
+{
+    if (count) flush();
+    if (levels.empty()) return;
+
+    levels.resize(1);
+    while (levels.back().size() > 1)
+    {
+        auto &below = levels.back();
+        std::vector<Bucket> level((below.size() + FACTOR - 1) / FACTOR, {INT16_MAX, INT16_MIN});
+
+        for (size_t i = 0; i < below.size(); ++i)
+        {
+            auto &bucket = level[i / FACTOR];
+            bucket.min = std::min(bucket.min, below[i].min);
+            bucket.max = std::max(bucket.max, below[i].max);
+        }
+
+        levels.push_back(std::move(level));
+    }
+}
+
+size_t Waveform::bytes() const
+{
+    size_t total = 0;
+    for (auto &level: levels) total += level.size() * sizeof(Bucket);
+
+    return total;
+}
+
+bool Waveform::save(const std::string &path) const
+{
+    if (empty()) return false;
+
+    std::ofstream file(path, std::ios::binary);
+    auto size = static_cast<uint64_t>(levels.front().size());
+    auto sampleRate = static_cast<int64_t>(rate);
+
+    file.write(reinterpret_cast<const char*>(&sampleRate), sizeof(sampleRate));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(levels.front().data()), static_cast<long>(size * sizeof(Bucket)));
+
+    return file.good();
+}
+
+bool Waveform::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    int64_t sampleRate = 0;
+    uint64_t size = 0;
+
+    if (!file.read(reinterpret_cast<char*>(&sampleRate), sizeof(sampleRate)) ||
+        !file.read(reinterpret_cast<char*>(&size), sizeof(size)) || sampleRate <= 0 || size > (1ULL << 32))
+        return false;
+
+    std::vector<Bucket> base(size);
+    if (!file.read(reinterpret_cast<char*>(base.data()), static_cast<long>(size * sizeof(Bucket)))) return false;
+
+    reset(static_cast<long>(sampleRate), start);
+    levels.front() = std::move(base);
+    finish();
+
+    return true;
+}
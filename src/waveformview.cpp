@@ -0,0 +1,58 @@
+#include "include/waveformview.h"
+
+#include <algorithm>
+
+#include <imgui/imgui.h>
+
+static constexpr float HEIGHT = 100.0f;
+
+void WaveformView::draw(const Waveform &waveform, double scroll, double msPerPixel)
+{
+    auto origin = ImGui::GetCursorScreenPos();
+    auto width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    ImGui::Dummy(ImVec2(width, HEIGHT));
+
+    auto drawList = ImGui::GetWindowDrawList();
+    ImVec2 end(origin.x + width, origin.y + HEIGHT);
+    drawList->AddRectFilled(origin, end, IM_COL32(20, 20, 24, 255));
+
+    auto rate = waveform.sampleRate();
+    auto &levels = waveform.pyramid();
+    if (waveform.empty() || rate <= 0) return;
+
+    // Pick the coarsest level whose buckets are still no wider than a pixel column.
+    auto samplesPerPixel = msPerPixel * static_cast<double>(rate) / 1000.0;
+    size_t level = 0, bucketSamples = Waveform::BASE;
+    while (level + 1 < levels.size() && static_cast<double>(bucketSamples * Waveform::FACTOR) <= samplesPerPixel)
+    {
+        ++level;
+        bucketSamples *= Waveform::FACTOR;
+    }
+
+    auto &buckets = levels[level];
+    auto middle = origin.y + HEIGHT / 2;
+    auto scale = HEIGHT / 2 / 32768.0f;
+
+    for (int column = 0; column < static_cast<int>(width); ++column)
+    {
+        auto from = (scroll + column * msPerPixel - waveform.startMs()) * static_cast<double>(rate) / 1000.0;
+        auto to = from + samplesPerPixel;
+        if (to < 0) continue;
+
+        auto first = static_cast<size_t>(std::max(from, 0.0)) / bucketSamples;
+        auto last = std::max(static_cast<size_t>(std::max(to, 0.0)) / bucketSamples, first + 1);
+        if (first >= buckets.size()) break;
+
+        int16_t low = INT16_MAX, high = INT16_MIN;
+        for (auto i = first; i < std::min(last, buckets.size()); ++i)
+        {
+            low = std::min(low, buckets[i].min);
+            high = std::max(high, buckets[i].max);
+        }
+
+        auto x = origin.x + static_cast<float>(column);
+        drawList->AddRectFilled(ImVec2(x, middle - static_cast<float>(high) * scale - 0.5f),
+                                ImVec2(x + 1, middle - static_cast<float>(low) * scale + 0.5f),
+                                IM_COL32(120, 200, 140, 255));
+    }
+}
@@ -0,0 +1,370 @@
+// Journal model check: applies random edits, undos and redos to a NoteSequence through a Journal and to a plain
+// std::vector that keeps a copy of every version, and compares the two after each step. Built with AddressSanitizer
+// and UBSan where the toolchain has them. Pass a number to use a different seed.
+
+#include <random>
+#include <string>
+#include <deque>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include "include/journal.h"
+
+using Notes = std::vector<std::pair<int, int>>;
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string &what)
+{
+    std::cout << (condition ? "  ok    " : "  FAIL  ") << what << std::endl;
+    if (!condition) ++failures;
+}
+
+// What the journal should do, spelled out with whole copies: each entry keeps the notes before and after it.
+struct Model
+{
+    struct Entry
+    {
+        Notes before, after;
+        bool linked, set;
+        size_t index;
+    };
+
+    Notes notes;
+    std::deque<Entry> undoEntries;
+    std::vector<Entry> redoEntries;
+    bool open = false, linkNext = false;
+    size_t dropped = 0;
+
+    void record(Notes before, bool set = false, size_t index = 0)
+    {
+        undoEntries.push_back({std::move(before), notes, linkNext, set, index});
+        linkNext = false;
+        redoEntries.clear();
+        if (undoEntries.size() > Journal::limit)
+        {
+            undoEntries.pop_front();
+            ++dropped;
+        }
+    }
+
+    void set(size_t index, std::pair<int, int> note)
+    {
+        auto before = notes;
+        notes[index] = note;
+        if (open && undoEntries.back().set && undoEntries.back().index == index)
+        {
+            undoEntries.back().after = notes;
+            redoEntries.clear();
+            return;
+        }
+
+        record(std::move(before), true, index);
+        open = true;
+    }
+
+    void swap(size_t index)
+    {
+        open = false;
+        auto before = notes;
+        std::swap(notes[index], notes[index + 1]);
+        record(std::move(before));
+    }
+
+    void rotate(size_t first, size_t middle, size_t last)
+    {
+        open = false;
+        auto before = notes;
+        std::rotate(notes.begin() + first, notes.begin() + middle, notes.begin() + last);
+        record(std::move(before));
+    }
+
+    void erase(size_t first, size_t last)
+    {
+        if (first >= last) return;
+
+        open = false;
+        auto before = notes;
+        notes.erase(notes.begin() + first, notes.begin() + last);
+        record(std::move(before));
+    }
+
+    void append(const Notes &added)
+    {
+        auto before = notes;
+        notes.insert(notes.end(), added.begin(), added.end());
+        if (added.empty()) return;
+
+        open = false;
+        record(std::move(before));
+    }
+
+    bool undo()
+    {
+        if (undoEntries.empty()) return false;
+
+        open = false;
+        bool linked;
+        do
+        {
+            auto entry = std::move(undoEntries.back());
+            undoEntries.pop_back();
+            linked = entry.linked;
+            notes = entry.before;
+            redoEntries.push_back(std::move(entry));
+        } while (linked && !undoEntries.empty());
+
+        return true;
+    }
+
+    bool redo()
+    {
+        if (redoEntries.empty()) return false;
+
+        open = false;
+        do
+        {
+            auto entry = std::move(redoEntries.back());
+            redoEntries.pop_back();
+            notes = entry.after;
+            undoEntries.push_back(std::move(entry));
+        } while (!redoEntries.empty() && redoEntries.back().linked);
+
+        return true;
+    }
+
+    void clear()
+    {
+        undoEntries.clear();
+        redoEntries.clear();
+        open = linkNext = false;
+    }
+};
+
+struct Checker
+{
+    std::mt19937 random;
+    NoteSequence data;
+    Journal journal{data};
+    Model model;
+    std::string mismatch;
+    int next = 1;
+
+    explicit Checker(unsigned int seed) : random(seed) {}
+
+    size_t pick(size_t bound) { return std::uniform_int_distribution<size_t>(0, bound)(random); }
+    std::pair<int, int> note() { return {next++, static_cast<int>(pick(1000))}; }
+
+    Notes notes(size_t count)
+    {
+        Notes added;
+        for (size_t i = 0; i < count; ++i) added.push_back(note());
+        return added;
+    }
+
+    void append(const Notes &added)
+    {
+        auto first = data.size();
+        data.append(added);
+        journal.appended(first);
+        model.append(added);
+    }
+
+    // One random step on both sides, with sequences kept below `size` notes.
+    std::string step(size_t size)
+    {
+        auto count = data.size();
+        switch (pick(13))
+        {
+            case 0:
+            case 1:
+            case 2:
+                if (count == 0) break;
+                {
+                    auto index = pick(count - 1);
+                    // Repeat the last note often, so slider drags merge.
+                    if (model.open && pick(1)) index = model.undoEntries.back().index;
+                    auto value = note();
+                    journal.set(index, value);
+                    model.set(index, value);
+                    return "set " + std::to_string(index);
+                }
+            case 3:
+                if (count < 2) break;
+                {
+                    auto index = pick(count - 2);
+                    journal.swap(index);
+                    model.swap(index);
+                    return "swap " + std::to_string(index);
+                }
+            case 4:
+            case 5:
+            {
+                auto first = pick(count), last = first + pick(count - first), middle = first + pick(last - first);
+                journal.rotate(first, middle, last);
+                model.rotate(first, middle, last);
+                return "rotate " + std::to_string(first) + " " + std::to_string(middle) + " " + std::to_string(last);
+            }
+            case 6:
+            {
+                auto first = pick(count), last = first + pick(std::min(count - first, size / 4));
+                journal.erase(first, last);
+                model.erase(first, last);
+                return "erase " + std::to_string(first) + " " + std::to_string(last);
+            }
+            case 7:
+            {
+                auto added = notes(pick(std::min(size / 4, size - std::min(size, count))));
+                append(added);
+                return "append " + std::to_string(added.size());
+            }
+            case 8:
+            {
+                // Loading a preset: replace everything and undo it in one step.
+                auto added = notes(pick(size / 2));
+                journal.erase(0, data.size());
+                model.erase(0, model.notes.size());
+                journal.link();
+                model.linkNext = true;
+                append(added);
+                return "preset " + std::to_string(added.size());
+            }
+            case 9:
+                journal.seal();
+                model.open = false;
+                return "seal";
+            case 10:
+            case 11:
+                return journal.undo() == model.undo() ? "undo" : "undo disagrees";
+            case 12:
+            case 13:
+                return journal.redo() == model.redo() ? "redo" : "redo disagrees";
+        }
+        return "nothing";
+    }
+
+    [[nodiscard]] std::string firstMismatch() const
+    {
+        return mismatch.empty() ? "" : " (first mismatch at " + mismatch + ")";
+    }
+
+    bool same(const std::string &what)
+    {
+        if (mismatch.empty() &&
+            (data.toVector() != model.notes || journal.canUndo() != !model.undoEntries.empty() ||
+             journal.canRedo() != !model.redoEntries.empty() || what.ends_with("disagrees")))
+        {
+            mismatch = what;
+        }
+        return mismatch.empty();
+    }
+};
+
+int main(int argc, char** argv)
+{
+    auto seed = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 1u;
+    std::cout << "Seed " << seed << std::endl;
+
+    {
+        std::cout << "NoteSequence against std::vector" << std::endl;
+        std::mt19937 random(seed);
+        auto pick = [&](size_t bound) { return std::uniform_int_distribution<size_t>(0, bound)(random); };
+        NoteSequence sequence;
+        Notes vector;
+        bool same = true;
+        int value = 0;
+
+        for (int i = 0; i < 4000 && same; ++i)
+        {
+            auto count = vector.size();
+            auto first = pick(count), last = first + pick(count - first);
+            switch (pick(3))
+            {
+                case 0:
+                {
+                    Notes added(pick(count < 8000 ? 3000 : 0));
+                    for (auto &note: added) note = {++value, 0};
+                    sequence.insert(first, added.data(), added.size());
+                    vector.insert(vector.begin() + first, added.begin(), added.end());
+                    break;
+                }
+                case 1:
+                    sequence.erase(first, last);
+                    vector.erase(vector.begin() + first, vector.begin() + last);
+                    break;
+                case 2:
+                {
+                    auto middle = first + pick(last - first);
+                    sequence.rotate(first, middle, last);
+                    std::rotate(vector.begin() + first, vector.begin() + middle, vector.begin() + last);
+                    break;
+                }
+                case 3:
+                    if (count == 0) break;
+                    sequence.set(first % count, {++value, 1});
+                    vector[first % count] = {value, 1};
+                    break;
+            }
+
+            same = sequence.size() == vector.size() && sequence.toVector() == vector &&
+                   std::equal(sequence.begin(), sequence.end(), vector.begin(), vector.end()) &&
+                   (vector.empty() || sequence[first % vector.size()] == vector[first % vector.size()]);
+        }
+        expect(same, "4000 inserts, erases, rotations and sets match");
+    }
+
+    {
+        std::cout << "Journal against a model with long sequences" << std::endl;
+        Checker checker(seed);
+        int steps = 0;
+        for (; steps < 20000 && checker.mismatch.empty(); ++steps)
+        {
+            auto what = checker.step(4000);
+            checker.same("step " + std::to_string(steps) + ": " + what);
+            if (steps % 500 == 499)
+            {
+                checker.journal.clear();
+                checker.model.clear();
+            }
+        }
+        expect(checker.mismatch.empty(), "20000 random steps match" + checker.firstMismatch());
+    }
+
+    {
+        std::cout << "Journal against a model past the entry limit" << std::endl;
+        Checker checker(seed + 1);
+        for (size_t i = 0; checker.model.dropped < 4000 && i < 4 * Journal::limit; ++i)
+        {
+            auto what = checker.step(16);
+            // Mostly take undos straight back, so the history outgrows the limit.
+            if (what == "undo" && checker.pick(7))
+            {
+                what = checker.journal.redo() == checker.model.redo() ? "undo, redo" : "redo disagrees";
+            }
+            if (!checker.same("step " + std::to_string(i) + ": " + what)) break;
+        }
+        expect(checker.mismatch.empty(),
+               "random steps match while the oldest entries are dropped" + checker.firstMismatch());
+        expect(checker.model.dropped >= 4000, std::to_string(checker.model.dropped) + " oldest entries were dropped");
+
+        size_t undone = 0;
+        while (checker.journal.canUndo() && checker.same("undo " + std::to_string(undone)))
+        {
+            checker.same(checker.journal.undo() == checker.model.undo() ? "undo" : "undo disagrees");
+            ++undone;
+        }
+        size_t redone = 0;
+        while (checker.journal.canRedo() && checker.same("redo " + std::to_string(redone)))
+        {
+            checker.same(checker.journal.redo() == checker.model.redo() ? "redo" : "redo disagrees");
+            ++redone;
+        }
+        expect(checker.mismatch.empty() && undone > 0 && undone == redone,
+               "undoing all " + std::to_string(undone) + " steps and redoing them matches");
+    }
+
+    std::cout << (failures ? std::to_string(failures) + " failed" : "All passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
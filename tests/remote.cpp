@@ -0,0 +1,302 @@
+// Remote import tests: runs the SoundCloud plugin against a local stand-in server. Exits with 77 (skipped) when the
+// plugin is not built.
+
+#include <thread>
+#include <csignal>
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+#include "include/hash.h"
+#include "include/soundtest.h"
+#include "server.h"
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string &what)
+{
+    std::cout << (condition ? "  ok    " : "  FAIL  ") << what << std::endl;
+    if (!condition) ++failures;
+}
+
+static std::string readFile(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// What a plugin source delivered into one sink.
+struct Capture
+{
+    std::string bytes;
+    size_t writes = 0;
+    std::chrono::steady_clock::time_point first, last;
+
+    SoundTestSink sink()
+    {
+        return {this, [](void*, long) {}, [](void* context, const void* data, size_t size)
+        {
+            auto &capture = *static_cast<Capture*>(context);
+            capture.last = std::chrono::steady_clock::now();
+            if (capture.writes++ == 0) capture.first = capture.last;
+            capture.bytes.append(static_cast<const char*>(data), size);
+            return 1;
+        }};
+    }
+};
+
+static size_t fetch(const std::vector<std::string> &ids, std::vector<Capture> &captures, std::vector<int> &ok)
+{
+    captures.assign(ids.size(), {});
+    ok.assign(ids.size(), 0);
+
+    std::vector<const char*> names;
+    std::vector<SoundTestSink> sinks;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        names.push_back(ids[i].c_str());
+        sinks.push_back(captures[i].sink());
+    }
+
+    return PluginRegistry::get("soundcloud")->fetch(names.data(), names.size(), sinks.data(), ok.data());
+}
+
+static void streaming(StandInServer &server, const std::string &song)
+{
+    std::cout << "Single tracks stream into the sink as they arrive" << std::endl;
+    server.track("stream", song, "stream-1");
+    server.throttle(64 << 10, std::chrono::milliseconds(20));
+    server.reset();
+
+    std::vector<Capture> captures;
+    std::vector<int> ok;
+    fetch({"stream"}, captures, ok);
+    server.throttle(0, {});
+
+    auto spread = std::chrono::duration_cast<std::chrono::milliseconds>(captures[0].last - captures[0].first);
+    expect(ok[0] && captures[0].bytes == song, "the body arrives complete");
+    expect(captures[0].writes > 1 && spread.count() >= 100, "the sink is fed while the transfer runs (" +
+                                                            std::to_string(captures[0].writes) + " writes over " +
+                                                            std::to_string(spread.count()) + " ms)");
+    expect(server.stats().authorization.starts_with("OAuth "), "the OAuth header is sent");
+    expect(!std::filesystem::exists("soundcloud_stream.mp3"), "no temporary file is left behind");
+}
+
+// Files the download cache holds for the track `id`, by extension.
+static std::set<std::string> cached(const std::string &id)
+{
+    std::set<std::string> extensions;
+    auto url = std::string(getenv("SOUNDCLOUD_API_URL")) + "/tracks/" + id + "/download";
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << Hash64::of(url.data(), url.size());
+
+    std::error_code ec;
+    for (auto &file: std::filesystem::directory_iterator(ImportCache::root() / "downloads", ec))
+        if (file.path().stem() == name.str()) extensions.insert(file.path().extension().string());
+    return extensions;
+}
+
+static void resuming(StandInServer &server, const std::string &song)
+{
+    std::cout << "Interrupted downloads resume, and finished ones are revalidated" << std::endl;
+    server.track("resume", song, "resume-1");
+    server.drop(2, 256 << 10);
+    server.reset();
+
+    std::vector<Capture> captures;
+    std::vector<int> ok;
+    fetch({"resume"}, captures, ok);
+    auto stats = server.stats();
+    expect(ok[0] && captures[0].bytes == song, "the body arrives complete after two disconnects");
+    expect(stats.dropped == 2 && stats.partial == 2 && stats.bodyBytes == song.size(),
+           "each retry asks only for the rest (" + std::to_string(stats.partial) + " ranges, " +
+           std::to_string(stats.bodyBytes) + " body bytes)");
+
+    server.reset();
+    fetch({"resume"}, captures, ok);
+    stats = server.stats();
+    expect(ok[0] && captures[0].bytes == song && stats.notModified == 1 && stats.bodyBytes == 0,
+           "an unchanged track is served from the cache");
+
+    auto changed = song.substr(1000);
+    server.track("resume", changed, "resume-2");
+    server.reset();
+    fetch({"resume"}, captures, ok);
+    stats = server.stats();
+    expect(ok[0] && captures[0].bytes == changed && stats.full == 1, "a changed track is downloaded again");
+
+    std::vector<std::string> ids, bodies;
+    for (int i = 0; i < 4; ++i)
+    {
+        ids.push_back("drop" + std::to_string(i));
+        bodies.push_back(song.substr(0, 300000) + ids.back());
+        server.track(ids.back(), bodies.back(), ids.back());
+    }
+
+    ids.push_back("drop0");
+    bodies.push_back(bodies[0]);
+    server.drop(3, 100000);
+    server.reset();
+    fetch(ids, captures, ok);
+    stats = server.stats();
+
+    auto complete = true;
+    for (size_t i = 0; i < ids.size(); ++i) complete = complete && ok[i] && captures[i].bytes == bodies[i];
+    expect(complete && stats.partial == 3, "a playlist resumes its interrupted tracks, and a repeated one is shared (" +
+                                           std::to_string(stats.requests) + " requests)");
+}
+
+static void fullDisk(StandInServer &server, const std::string &song)
+{
+    std::cout << "A download that cannot be cached still arrives whole" << std::endl;
+    server.track("full", song, "full-1");
+    server.track("fullA", song + "A", "fullA");
+    server.track("fullB", song + "B", "fullB");
+
+    // Writes past the limit fail with EFBIG, as they would on a full disk.
+    rlimit previous{}, limit{};
+    getrlimit(RLIMIT_FSIZE, &previous);
+    limit = previous;
+    limit.rlim_cur = 256 << 10;
+    auto handler = signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    std::vector<Capture> captures;
+    std::vector<int> ok;
+    fetch({"full"}, captures, ok);
+    expect(ok[0] && captures[0].bytes == song, "a streamed track is not truncated");
+    expect(!cached("full").contains(".body") && !cached("full").contains(".part"), "nothing short is kept");
+
+    fetch({"fullA", "fullB"}, captures, ok);
+    expect(ok[0] && ok[1] && captures[0].bytes == song + "A" && captures[1].bytes == song + "B",
+           "playlist tracks are not truncated");
+    expect(!cached("fullA").contains(".body") && !cached("fullA").contains(".part"), "nothing short is kept");
+
+    setrlimit(RLIMIT_FSIZE, &previous);
+    signal(SIGXFSZ, handler);
+}
+
+static void concurrent(StandInServer &server, const std::string &song)
+{
+    std::cout << "Importers sharing the cache download a track once" << std::endl;
+    server.track("shared", song, "shared-1");
+    server.throttle(64 << 10, std::chrono::milliseconds(10));
+    server.reset();
+
+    std::vector<Capture> first, second;
+    std::vector<int> firstOk, secondOk;
+    std::thread other([&] { fetch({"shared"}, second, secondOk); });
+    fetch({"shared"}, first, firstOk);
+    other.join();
+    server.throttle(0, {});
+
+    auto stats = server.stats();
+    expect(firstOk[0] && secondOk[0] && first[0].bytes == song && second[0].bytes == song, "both get the whole body");
+    expect(stats.full == 1 && stats.notModified == 1, "the second waits for the first and revalidates its copy");
+}
+
+static void decoding(StandInServer &server, const std::string &song, const std::filesystem::path &data)
+{
+    std::cout << "A streamed track decodes to the same notes as the local file" << std::endl;
+    server.track("decode", song, "decode-1");
+
+    std::vector<std::pair<int, int>> local, remote;
+    ImportCache::enabled = false;
+    if (!AudioManager::importMP3(local, (data / "4.mp3").c_str()))
+    {
+        std::cout << "  skip  the MP3 decoder is unavailable" << std::endl;
+        return;
+    }
+
+    expect(AudioManager::importSoundCloud(remote, "decode") && remote == local,
+           "importSoundCloud matches importMP3 (" + std::to_string(remote.size()) + " notes)");
+}
+
+static void playlist(StandInServer &server, const std::string &song)
+{
+    std::cout << "Playlists download concurrently over reused connections" << std::endl;
+    std::vector<std::string> ids, bodies;
+    for (int i = 0; i < 20; ++i)
+    {
+        ids.push_back("list" + std::to_string(i));
+        bodies.push_back(song.substr(0, 200000) + ids.back());
+        server.track(ids.back(), bodies.back(), ids.back());
+    }
+    ids.emplace_back("missing");
+
+    // Each body takes about 100 ms to send, so fetching them one after another would take 2 s.
+    server.throttle(50000, std::chrono::milliseconds(25));
+    server.reset();
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Capture> captures;
+    std::vector<int> ok;
+    auto fetched = fetch(ids, captures, ok);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    server.throttle(0, {});
+
+    auto complete = true;
+    for (size_t i = 0; i + 1 < ids.size(); ++i)
+        complete = complete && ok[i] && captures[i].writes == 1 && captures[i].bytes == bodies[i];
+
+    auto stats = server.stats();
+    expect(fetched == 20 && complete, "every track arrives whole, in one write to its own sink");
+    expect(!ok.back() && captures.back().bytes.empty(), "the missing track fails on its own");
+    expect(stats.connections <= SOUNDCLOUD_CONCURRENCY && stats.requests == ids.size(),
+           std::to_string(stats.requests) + " requests share " + std::to_string(stats.connections) + " connections");
+    expect(elapsed.count() < 1000, "transfers overlap (" + std::to_string(elapsed.count()) + " ms)");
+}
+
+static void playlistDecoding(StandInServer &server, const std::string &song, const std::filesystem::path &data)
+{
+    std::cout << "A playlist decodes to the same notes as its local files" << std::endl;
+    server.track("listA", song, "listA");
+    server.track("listB", song, "listB");
+
+    std::vector<std::pair<int, int>> local, remote;
+    ImportCache::enabled = false;
+    if (!AudioManager::importMP3(local, (data / "4.mp3").c_str()))
+    {
+        std::cout << "  skip  the MP3 decoder is unavailable" << std::endl;
+        return;
+    }
+
+    auto twice = local;
+    twice.insert(twice.end(), local.begin(), local.end());
+    expect(AudioManager::importSoundCloudPlaylist(remote, "listA, listB") && remote == twice,
+           "importSoundCloudPlaylist matches importMP3 for each track, in order");
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path data = argc > 1 ? argv[1] : SOUNDTEST_TEST_DATA;
+
+    // Keep the download cache away from the user's, and point the plugin at the stand-in before it is loaded.
+    char scratch[] = "/tmp/soundtest-remote-XXXXXX";
+    if (!mkdtemp(scratch)) return EXIT_FAILURE;
+    setenv("XDG_CACHE_HOME", scratch, 1);
+
+    StandInServer server;
+    setenv("SOUNDCLOUD_API_URL", server.url().c_str(), 1);
+    if (!PluginRegistry::get("soundcloud")) return 77;
+
+    auto song = readFile(data / "4.mp3");
+    if (song.empty())
+    {
+        std::cerr << "Missing test data in " << data << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    streaming(server, song);
+    decoding(server, song, data);
+    playlist(server, song);
+    resuming(server, song);
+    fullDisk(server, song);
+    concurrent(server, song);
+    playlistDecoding(server, song, data);
+
+    std::error_code ec;
+    std::filesystem::remove_all(scratch, ec);
+    std::cout << (failures ? std::to_string(failures) + " failed" : "All passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
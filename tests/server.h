@@ -0,0 +1,258 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <strings.h>
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Local stand-in for the SoundCloud API, serving /tracks/<id>/download over HTTP/1.1 with keep-alive, ETags,
+// If-None-Match, Range and If-Range. It can throttle bodies and cut connections mid-body, and counts what it served so
+// tests can tell a resumed or revalidated download from a full one.
+class StandInServer
+{
+public:
+    struct Stats
+    {
+        size_t connections = 0, requests = 0, full = 0, partial = 0, notModified = 0, dropped = 0;
+        // Body bytes sent, whether or not the connection was cut.
+        size_t bodyBytes = 0;
+        std::string authorization;
+    };
+
+    StandInServer()
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(listenFd, 64);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+
+        acceptor = std::thread([this]
+                               {
+                                   for (int fd; (fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0;)
+                                   {
+                                       std::lock_guard lock(mutex);
+                                       ++counters.connections;
+                                       clients.insert(fd);
+                                       connections.emplace_back(&StandInServer::serve, this, fd);
+                                   }
+                               });
+    }
+
+    StandInServer(const StandInServer &) = delete;
+    StandInServer &operator=(const StandInServer &) = delete;
+
+    ~StandInServer()
+    {
+        shutdown(listenFd, SHUT_RDWR);
+        acceptor.join();
+        {
+            std::lock_guard lock(mutex);
+            for (auto fd: clients) shutdown(fd, SHUT_RDWR);
+        }
+
+        for (auto &connection: connections) connection.join();
+        close(listenFd);
+    }
+
+    [[nodiscard]] std::string url() const { return "http://127.0.0.1:" + std::to_string(port); }
+
+    void track(const std::string &id, std::string body, std::string etag)
+    {
+        std::lock_guard lock(mutex);
+        tracks[id] = {std::move(body), "\"" + etag + "\""};
+    }
+
+    // The next `count` responses with a body are cut off after `bytes` of it.
+    void drop(int count, size_t bytes)
+    {
+        std::lock_guard lock(mutex);
+        drops = count;
+        dropAfter = bytes;
+    }
+
+    // Sends bodies `chunk` bytes at a time with `delay` in between; a zero chunk sends them at once.
+    void throttle(size_t chunk, std::chrono::milliseconds delay)
+    {
+        std::lock_guard lock(mutex);
+        chunkSize = chunk;
+        chunkDelay = delay;
+    }
+
+    [[nodiscard]] Stats stats() const
+    {
+        std::lock_guard lock(mutex);
+        return counters;
+    }
+
+    void reset()
+    {
+        std::lock_guard lock(mutex);
+        counters = {};
+    }
+
+private:
+    static std::string header(const std::string &request, const char* name)
+    {
+        auto length = strlen(name);
+        for (size_t line = request.find("\r\n"); line != std::string::npos; line = request.find("\r\n", line + 2))
+            if (strncasecmp(request.c_str() + line + 2, name, length) == 0 && request[line + 2 + length] == ':')
+            {
+                auto value = request.substr(line + 3 + length, request.find("\r\n", line + 2) - line - 3 - length);
+                value.erase(0, value.find_first_not_of(' '));
+                return value;
+            }
+
+        return {};
+    }
+
+    static bool sendAll(int fd, const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            auto sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+
+        return true;
+    }
+
+    void serve(int fd)
+    {
+        std::string buffer;
+        char chunk[4096];
+        for (bool alive = true; alive;)
+        {
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                auto received = recv(fd, chunk, sizeof(chunk), 0);
+                if (received <= 0)
+                {
+                    alive = false;
+                    break;
+                }
+
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+
+            if (!alive) break;
+            auto request = buffer.substr(0, end + 2);
+            buffer.erase(0, end + 4);
+            alive = respond(fd, request);
+        }
+
+        std::lock_guard lock(mutex);
+        clients.erase(fd);
+        close(fd);
+    }
+
+    // Returns false once the connection is to be closed.
+    bool respond(int fd, const std::string &request)
+    {
+        std::string body, etag, status = "200 OK", extra;
+        size_t from = 0, cut = SIZE_MAX, piece;
+        std::chrono::milliseconds delay;
+        bool found;
+        {
+            std::lock_guard lock(mutex);
+            ++counters.requests;
+            counters.authorization = header(request, "Authorization");
+
+            auto path = request.substr(request.find(' ') + 1);
+            path.erase(path.find(' '));
+            auto id = path.starts_with("/tracks/") && path.ends_with("/download") ? path.substr(8, path.size() - 17)
+                                                                                   : "";
+            auto track = tracks.find(id);
+            found = track != tracks.end();
+            if (found)
+            {
+                body = track->second.first;
+                etag = track->second.second;
+            }
+
+            piece = chunkSize;
+            delay = chunkDelay;
+            auto range = header(request, "Range"), condition = header(request, "If-Range");
+            if (!found) status = "404 Not Found";
+            else if (header(request, "If-None-Match") == etag)
+            {
+                status = "304 Not Modified";
+                ++counters.notModified;
+            }
+            else if (range.starts_with("bytes=") && (condition.empty() || condition == etag))
+            {
+                from = std::stoul(range.substr(6));
+                if (from >= body.size())
+                {
+                    status = "416 Range Not Satisfiable";
+                    extra = "Content-Range: bytes */" + std::to_string(body.size()) + "\r\n";
+                }
+                else
+                {
+                    status = "206 Partial Content";
+                    extra = "Content-Range: bytes " + std::to_string(from) + "-" + std::to_string(body.size() - 1) +
+                            "/" + std::to_string(body.size()) + "\r\n";
+                    ++counters.partial;
+                }
+            }
+            else ++counters.full;
+
+            if (!status.starts_with("200") && !status.starts_with("206")) body.clear();
+            else if (drops > 0)
+            {
+                --drops;
+                ++counters.dropped;
+                cut = dropAfter;
+            }
+        }
+
+        auto length = body.size() - std::min(from, body.size());
+        auto head = "HTTP/1.1 " + status + "\r\nContent-Length: " + std::to_string(length) + "\r\n" + extra +
+                    (found ? "ETag: " + etag + "\r\n" : "") + "Connection: keep-alive\r\n\r\n";
+        if (!sendAll(fd, head.data(), head.size())) return false;
+
+        auto limit = std::min(body.size(), from + std::min(cut, length));
+        for (auto offset = from; offset < limit;)
+        {
+            auto size = std::min(limit - offset, piece ? piece : limit - offset);
+            if (!sendAll(fd, body.data() + offset, size)) return false;
+            {
+                std::lock_guard lock(mutex);
+                counters.bodyBytes += size;
+            }
+
+            offset += size;
+            if (piece && offset < limit) std::this_thread::sleep_for(delay);
+        }
+
+        return cut == SIZE_MAX;
+    }
+
+    int listenFd, port = 0;
+    std::thread acceptor;
+    std::vector<std::thread> connections;
+    std::set<int> clients;
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::pair<std::string, std::string>> tracks;
+    int drops = 0;
+    size_t dropAfter = 0, chunkSize = 0;
+    std::chrono::milliseconds chunkDelay{0};
+    Stats counters;
+};